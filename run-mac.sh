@@ -2,7 +2,13 @@
 cd "$(dirname "$0")"
 
 # compile
-clang -O3 -Wno-deprecated-declarations -o mapview -lglfw -framework OpenGL src/main.c src/util.c src/texture.c src/model.c &&
+clang -O3 -Wno-deprecated-declarations -o mapview -lglfw -framework OpenGL src/main.c src/util.c src/texture.c src/model.c src/sector.c src/prefetch.c src/jobs.c src/decode.c src/placement.c src/frustum.c src/terrain.c src/atlas.c src/matrix.c src/world.c src/render_gl.c src/profile.c src/trace.c &&
+
+# pack the sector files into a single archive and compile the model placements
+clang -O3 -Isrc -o sectorpack tools/sectorpack.c src/sector.c src/util.c &&
+./sectorpack data/sectors/ data/sectors.pak &&
+clang -O3 -Isrc -o locpack tools/locpack.c src/placement.c src/sector.c src/util.c &&
+./locpack data/model_locs.csv data/model_locs.bin &&
 
 # run
 ./mapview
\ No newline at end of file
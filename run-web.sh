@@ -1,23 +1,42 @@
 #!/bin/sh
 cd "$(dirname "$0")"
 
+# pack the sector files and the model placements (the tools are built for the host)
+cc -O3 -Isrc -o sectorpack tools/sectorpack.c src/sector.c src/util.c &&
+./sectorpack data/sectors/ data/sectors.pak &&
+cc -O3 -Isrc -o locpack tools/locpack.c src/placement.c src/sector.c src/util.c &&
+./locpack data/model_locs.csv data/model_locs.bin &&
+
 # compile
 emcc    src/main.c \
         src/model.c \
         src/texture.c \
         src/util.c \
+        src/sector.c \
+        src/prefetch.c \
+        src/jobs.c \
+        src/decode.c \
+        src/placement.c \
+        src/frustum.c \
+        src/terrain.c \
+        src/atlas.c \
+        src/matrix.c \
+        src/world.c \
+        src/render_gl.c \
+        src/profile.c \
+        src/trace.c \
         -O3 \
         -s LEGACY_GL_EMULATION=1 \
         -s GL_FFP_ONLY=1 \
         -s STB_IMAGE=1 \
         -s USE_GLFW=3 \
         -o ./web/index.js \
-        --preload-file ./data/sectors \
+        --preload-file ./data/sectors.pak \
         --preload-file ./data/textures/ground \
         --preload-file ./data/textures/wall \
         --preload-file ./data/textures/model \
         --preload-file ./data/models \
-        --preload-file ./data/model_locs.csv
+        --preload-file ./data/model_locs.bin
 #&&
 # run
 #emrun ./web/index.html --browser chrome
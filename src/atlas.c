@@ -0,0 +1,146 @@
+/*
+ * packs the textures of a family into one power of two texture with simple
+ * shelves, tallest images first, so that a whole family needs a single bind.
+ * the layout only needs the image sizes, so an atlas can be uploaded with
+ * placeholder cells and have its images blitted in as they are decoded.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "atlas.h"
+#include "util.h"
+
+#define ATLAS_WHITE_SIZE 4
+
+static int atlas_image_compare(const void *a, const void *b) {
+    const struct AtlasImage *image_a = a, *image_b = b;
+
+    if (image_a->height != image_b->height) return image_a->height > image_b->height ? -1 : 1;
+    return image_a->id < image_b->id ? -1 : image_a->id > image_b->id;
+}
+
+static uint16_t atlas_pow2(unsigned n) {
+    unsigned size = 1;
+    while (size < n) size <<= 1;
+    return size;
+}
+
+/* copies an image into its cell, repeating its edge texels into the padding. cells don't overlap */
+void atlas_blit(struct TextureAtlas *atlas, const struct AtlasImage *image) {
+    unsigned w = image->width, h = image->height;
+
+    for (unsigned row = 0; row < h + ATLAS_PADDING * 2; row++) {
+        int src_row = (int) row - ATLAS_PADDING;
+        src_row = src_row < 0 ? 0 : src_row >= (int) h ? (int) h - 1 : src_row;
+
+        uint8_t *dst = atlas->pixels + ((size_t) (image->y + row) * atlas->width + image->x) * 4;
+        const uint8_t *src = image->pixels + (size_t) src_row * w * 4;
+
+        for (unsigned i = 0; i < ATLAS_PADDING; i++) {
+            memcpy(dst + i * 4, src, 4);
+            memcpy(dst + (ATLAS_PADDING + w + i) * 4, src + (w - 1) * 4, 4);
+        }
+        memcpy(dst + ATLAS_PADDING * 4, src, w * 4);
+    }
+}
+
+/* the mean color of an image, which stands in for it where it is too small to see */
+void atlas_average(struct TextureAtlas *atlas, const struct AtlasImage *image) {
+    size_t count = (size_t) image->width * image->height;
+    uint64_t sum[3] = { 0, 0, 0 };
+
+    for (size_t i = 0; i < count; i++) {
+        for (unsigned c = 0; c < 3; c++) {
+            sum[c] += image->pixels[i * 4 + c];
+        }
+    }
+    for (unsigned c = 0; c < 3; c++) {
+        atlas->colors[image->id][c] = count ? sum[c] / count : ATLAS_PLACEHOLDER;
+    }
+}
+
+/* fills the cell of an image that hasn't been decoded yet */
+static void atlas_fill(struct TextureAtlas *atlas, const struct AtlasImage *image, uint8_t value) {
+    for (unsigned row = 0; row < image->height + ATLAS_PADDING * 2u; row++) {
+        uint8_t *dst = atlas->pixels + ((size_t) (image->y + row) * atlas->width + image->x) * 4;
+        for (unsigned i = 0; i < image->width + ATLAS_PADDING * 2u; i++, dst += 4) {
+            dst[0] = dst[1] = dst[2] = value;
+            dst[3] = 255;
+        }
+    }
+}
+
+static struct AtlasRegion atlas_region(struct TextureAtlas *atlas, unsigned x, unsigned y, unsigned w, unsigned h) {
+    return (struct AtlasRegion) {
+        (float) (x + ATLAS_PADDING) / atlas->width,
+        (float) (y + ATLAS_PADDING) / atlas->height,
+        (float) (x + ATLAS_PADDING + w) / atlas->width,
+        (float) (y + ATLAS_PADDING + h) / atlas->height
+    };
+}
+
+/*
+ * places the images (sorted in place, tallest first) and sets every region. the
+ * pixels start out as placeholders, atlas_blit() fills in the decoded images.
+ */
+void atlas_layout(struct TextureAtlas *atlas, struct AtlasImage *images, unsigned count) {
+    static uint8_t white_pixels[ATLAS_WHITE_SIZE * ATLAS_WHITE_SIZE * 4];
+    memset(white_pixels, 255, sizeof(white_pixels));
+
+    qsort(images, count, sizeof(struct AtlasImage), atlas_image_compare);
+    /* the white cell is the smallest, so it is placed last */
+    struct AtlasImage white_image = { 0, ATLAS_WHITE_SIZE, ATLAS_WHITE_SIZE, 0, 0, white_pixels };
+
+    /* first pass places the images on shelves, the pixels are allocated once the size is known */
+    unsigned x = 0, y = 0, shelf = 0;
+
+    for (unsigned i = 0; i <= count; i++) {
+        struct AtlasImage *image = i < count ? &images[i] : &white_image;
+        unsigned w = image->width + ATLAS_PADDING * 2;
+        unsigned h = image->height + ATLAS_PADDING * 2;
+
+        if (w > ATLAS_WIDTH) ABORT("texture %u too wide for the atlas", image->id);
+        if (x + w > ATLAS_WIDTH) {
+            x = 0;
+            y += shelf;
+            shelf = 0;
+        }
+        image->x = x;
+        image->y = y;
+        x += w;
+        if (h > shelf) shelf = h;
+    }
+
+    atlas->width = ATLAS_WIDTH;
+    atlas->height = atlas_pow2(y + shelf);
+    atlas->pixels = xmalloc((size_t) atlas->width * atlas->height * 4);
+    memset(atlas->pixels, 0, (size_t) atlas->width * atlas->height * 4);
+    atlas->complete = false;
+
+    for (unsigned i = 0; i < count; i++) {
+        atlas_fill(atlas, &images[i], ATLAS_PLACEHOLDER);
+    }
+    atlas_blit(atlas, &white_image);
+
+    /* the white region collapses to the center texel of its cell so any uv samples white */
+    struct AtlasRegion white = atlas_region(atlas, white_image.x, white_image.y, ATLAS_WHITE_SIZE, ATLAS_WHITE_SIZE);
+    white.u0 = white.u1 = (white.u0 + white.u1) / 2;
+    white.v0 = white.v1 = (white.v0 + white.v1) / 2;
+    atlas->white = white;
+
+    for (unsigned id = 0; id < ATLAS_MAX_IMAGES; id++) {
+        atlas->regions[id] = white;
+        memset(atlas->colors[id], 255, 3);
+    }
+    for (unsigned i = 0; i < count; i++) {
+        if (images[i].id >= ATLAS_MAX_IMAGES) ABORT("texture id %u out of range", images[i].id);
+        atlas->regions[images[i].id] = atlas_region(atlas, images[i].x, images[i].y,
+                                                    images[i].width, images[i].height);
+        memset(atlas->colors[images[i].id], ATLAS_PLACEHOLDER, 3);
+    }
+}
+
+/* maps texture coordinates of a single image to the atlas */
+void atlas_uv(const struct AtlasRegion *region, float s, float t, float *u, float *v) {
+    *u = region->u0 + s * (region->u1 - region->u0);
+    *v = region->v0 + t * (region->v1 - region->v0);
+}
@@ -0,0 +1,41 @@
+#ifndef ATLAS_H_INCLUDED
+#define ATLAS_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ATLAS_MAX_IMAGES    256  /* texture ids of a family, as in the file names */
+#define ATLAS_WIDTH         1024
+#define ATLAS_PADDING       2    /* texels of repeated edge around every image, emulates GL_CLAMP */
+#define ATLAS_PLACEHOLDER   0x80 /* grey shown in place of an image until it is decoded */
+
+/* a decoded texture, rows as stored in the file, rgba */
+struct AtlasImage {
+    uint16_t id;
+    uint16_t width, height;
+    uint16_t x, y; /* cell in the atlas, set by atlas_layout() */
+    uint8_t *pixels;
+};
+
+struct AtlasRegion {
+    float u0, v0, u1, v1;
+};
+
+/* one texture family packed into a single texture */
+struct TextureAtlas {
+    uint32_t texture; /* GL texture name, set once uploaded */
+    uint16_t width, height;
+    uint8_t *pixels;  /* rgba, only kept until the complete atlas is uploaded to GL */
+    bool transparent; /* alpha is kept, otherwise every texel is opaque */
+    bool complete;    /* every image has been blitted, before that some cells hold the placeholder */
+    struct AtlasRegion regions[ATLAS_MAX_IMAGES]; /* by texture id, missing ids map to a white texel */
+    struct AtlasRegion white;
+    uint8_t colors[ATLAS_MAX_IMAGES][3]; /* mean rgb of every image by id, only final once complete */
+};
+
+void atlas_layout(struct TextureAtlas *atlas, struct AtlasImage *images, unsigned count);
+void atlas_blit(struct TextureAtlas *atlas, const struct AtlasImage *image);
+void atlas_average(struct TextureAtlas *atlas, const struct AtlasImage *image);
+void atlas_uv(const struct AtlasRegion *region, float s, float t, float *u, float *v);
+
+#endif // ATLAS_H_INCLUDED
@@ -0,0 +1,387 @@
+/*
+ * byte swapping, tile de-interleaving and tile crop kernels. every instruction set gets its
+ * own set of kernels with the same results as the scalar ones; the fastest one the
+ * cpu supports is picked at runtime (x86 builds always have sse2, avx2 is checked
+ * for, aarch64 always has neon). the vector loops leave any remainder to scalar code.
+ */
+#include <stdatomic.h>
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+    #include <emmintrin.h>
+    #define HAVE_SSE2
+    #if defined(__GNUC__)
+        #include <immintrin.h>
+        #define HAVE_AVX2
+    #endif
+#elif defined(__aarch64__) && defined(__ARM_NEON) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    #include <arm_neon.h>
+    #define HAVE_NEON
+#endif
+
+#include "decode.h"
+
+static void be16_scalar(uint16_t *restrict dst, const uint8_t *restrict src, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = (uint16_t) (src[i * 2] << 8 | src[i * 2 + 1]);
+    }
+}
+
+static void be32_scalar(uint32_t *restrict dst, const uint8_t *restrict src, size_t count) {
+    for (size_t i = 0; i < count; i++, src += 4) {
+        dst[i] = (uint32_t) src[0] << 24 | src[1] << 16 | src[2] << 8 | src[3];
+    }
+}
+
+static void tiles_scalar(const struct TileFields *restrict dst, const uint8_t *restrict src, size_t count, bool underground) {
+    for (size_t i = 0; i < count; i++, src += TILE_RECORD_SIZE) {
+        dst->height[i]     = underground ? 0 : src[0];
+        dst->color[i]      = src[1];
+        dst->texture[i]    = src[2];
+        dst->roof[i]       = src[3];
+        dst->wall_east[i]  = src[4];
+        dst->wall_north[i] = src[5];
+        dst->wall_diag[i]  = src[8] << 8 | src[9];
+    }
+}
+
+/*
+ * crop style of a textured tile by which of its neighbours are textured too:
+ * north (z-1) 8, south (z+1) 4, east (x-1) 2, west (x+1) 1
+ */
+static const uint8_t crop_styles[16] = {
+    CROP_TOP_RIGHT, CROP_TOP_RIGHT, CROP_BOTTOM_LEFT, CROP_NONE,
+    CROP_TOP_RIGHT, CROP_TOP_RIGHT, CROP_TOP_LEFT, CROP_NONE,
+    CROP_BOTTOM_LEFT, CROP_BOTTOM_RIGHT, CROP_BOTTOM_LEFT, CROP_NONE,
+    CROP_NONE, CROP_NONE, CROP_NONE, CROP_NONE
+};
+
+static void crops_scalar(uint8_t *restrict dst, const uint8_t *restrict texture) {
+    for (unsigned x = 0; x < 48; x++) {
+        for (unsigned z = 0; z < 48; z++) {
+            const uint8_t *tile = texture + x * 48 + z;
+            unsigned mask = (z > 0 && tile[-1]) << 3 | (z < 47 && tile[1]) << 2
+                          | (x > 0 && tile[-48]) << 1 | (x < 47 && tile[48]);
+            dst[x * 48 + z] = *tile ? crop_styles[mask] : CROP_NONE;
+        }
+    }
+}
+
+#ifdef HAVE_SSE2
+static __m128i swap16_sse2(__m128i v) {
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static void be16_sse2(uint16_t *restrict dst, const uint8_t *restrict src, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (src + i * 2));
+        _mm_storeu_si128((__m128i*) (dst + i), swap16_sse2(v));
+    }
+    be16_scalar(dst + i, src + i * 2, count - i);
+}
+
+static void be32_sse2(uint32_t *restrict dst, const uint8_t *restrict src, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        /* swap the bytes of each half, then the halves */
+        __m128i v = swap16_sse2(_mm_loadu_si128((const __m128i*) (src + i * 4)));
+        v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128((__m128i*) (dst + i), v);
+    }
+    be32_scalar(dst + i, src + i * 4, count - i);
+}
+
+/* two records as two 8 byte tiles: the 6 byte fields followed by the diagonal wall, little endian */
+static __m128i tile_pair_sse2(const uint8_t *src) {
+    const __m128i fields = _mm_set_epi8(0, 0, -1, -1, -1, -1, -1, -1, 0, 0, -1, -1, -1, -1, -1, -1);
+    __m128i head = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*) src),
+                                      _mm_loadl_epi64((const __m128i*) (src + TILE_RECORD_SIZE)));
+    __m128i tail = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*) (src + 2)),
+                                      _mm_loadl_epi64((const __m128i*) (src + TILE_RECORD_SIZE + 2)));
+    return _mm_or_si128(_mm_and_si128(head, fields), _mm_andnot_si128(fields, swap16_sse2(tail)));
+}
+
+/*
+ * transposes eight 8 byte tiles (two per register, in order) into the field arrays:
+ * interleaving bytes twice groups each field of four tiles, interleaving those
+ * groups gathers each field of all eight.
+ */
+static void tiles_store_sse2(const struct TileFields *dst, size_t i, __m128i a, __m128i b, __m128i c, __m128i d,
+                             bool underground) {
+    __m128i ab_lo = _mm_unpacklo_epi8(a, b), ab_hi = _mm_unpackhi_epi8(a, b);
+    __m128i cd_lo = _mm_unpacklo_epi8(c, d), cd_hi = _mm_unpackhi_epi8(c, d);
+    __m128i first_lo = _mm_unpacklo_epi8(ab_lo, ab_hi), first_hi = _mm_unpackhi_epi8(ab_lo, ab_hi);
+    __m128i last_lo = _mm_unpacklo_epi8(cd_lo, cd_hi), last_hi = _mm_unpackhi_epi8(cd_lo, cd_hi);
+
+    __m128i height_color = _mm_unpacklo_epi32(first_lo, last_lo);
+    __m128i texture_roof = _mm_unpackhi_epi32(first_lo, last_lo);
+    __m128i walls = _mm_unpacklo_epi32(first_hi, last_hi);
+    __m128i diag = _mm_unpackhi_epi32(first_hi, last_hi);
+
+    _mm_storel_epi64((__m128i*) (dst->height + i), underground ? _mm_setzero_si128() : height_color);
+    _mm_storel_epi64((__m128i*) (dst->color + i), _mm_unpackhi_epi64(height_color, height_color));
+    _mm_storel_epi64((__m128i*) (dst->texture + i), texture_roof);
+    _mm_storel_epi64((__m128i*) (dst->roof + i), _mm_unpackhi_epi64(texture_roof, texture_roof));
+    _mm_storel_epi64((__m128i*) (dst->wall_east + i), walls);
+    _mm_storel_epi64((__m128i*) (dst->wall_north + i), _mm_unpackhi_epi64(walls, walls));
+    _mm_storeu_si128((__m128i*) (dst->wall_diag + i), _mm_unpacklo_epi8(diag, _mm_srli_si128(diag, 8)));
+}
+
+static void tiles_sse2(const struct TileFields *restrict dst, const uint8_t *restrict src, size_t count, bool underground) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8, src += TILE_RECORD_SIZE * 8) {
+        tiles_store_sse2(dst, i, tile_pair_sse2(src), tile_pair_sse2(src + 20),
+                         tile_pair_sse2(src + 40), tile_pair_sse2(src + 60), underground);
+    }
+    struct TileFields rest = {
+        dst->height + i, dst->texture + i, dst->color + i, dst->roof + i,
+        dst->wall_east + i, dst->wall_north + i, dst->wall_diag + i
+    };
+    tiles_scalar(&rest, src, count - i, underground);
+}
+
+/* 0xff for every textured tile of the 16 starting at p */
+static __m128i textured_sse2(const uint8_t *p) {
+    __m128i untextured = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) p), _mm_setzero_si128());
+    return _mm_xor_si128(untextured, _mm_set1_epi8(-1));
+}
+
+/*
+ * crop_styles as bit logic on the textured masks of 16 tiles and of their neighbours
+ * on each side. the four styles can't overlap, so they are simply or'ed together.
+ */
+static __m128i crop_select_sse2(__m128i t, __m128i n, __m128i s, __m128i e, __m128i w) {
+    __m128i top_right = _mm_andnot_si128(_mm_or_si128(n, e), t);
+    __m128i top_left = _mm_andnot_si128(_mm_or_si128(n, w), _mm_and_si128(t, _mm_and_si128(s, e)));
+    __m128i bottom_right = _mm_andnot_si128(_mm_or_si128(s, e), _mm_and_si128(t, _mm_and_si128(n, w)));
+    __m128i bottom_left = _mm_andnot_si128(_mm_or_si128(s, w), _mm_and_si128(t, _mm_or_si128(n, e)));
+    return _mm_or_si128(_mm_or_si128(_mm_and_si128(top_right, _mm_set1_epi8(CROP_TOP_RIGHT)),
+                                     _mm_and_si128(top_left, _mm_set1_epi8(CROP_TOP_LEFT))),
+                        _mm_or_si128(_mm_and_si128(bottom_right, _mm_set1_epi8(CROP_BOTTOM_RIGHT)),
+                                     _mm_and_si128(bottom_left, _mm_set1_epi8(CROP_BOTTOM_LEFT))));
+}
+
+/* a row is three vectors, the first and last get their outer z neighbour by shifting in an untextured tile */
+static void crops_sse2(uint8_t *restrict dst, const uint8_t *restrict texture) {
+    for (unsigned x = 0; x < 48; x++) {
+        for (unsigned z = 0; z < 48; z += 16) {
+            const uint8_t *tile = texture + x * 48 + z;
+            __m128i t = textured_sse2(tile);
+            __m128i n = z == 0 ? _mm_slli_si128(t, 1) : textured_sse2(tile - 1);
+            __m128i s = z == 32 ? _mm_srli_si128(t, 1) : textured_sse2(tile + 1);
+            __m128i e = x > 0 ? textured_sse2(tile - 48) : _mm_setzero_si128();
+            __m128i w = x < 47 ? textured_sse2(tile + 48) : _mm_setzero_si128();
+            _mm_storeu_si128((__m128i*) (dst + x * 48 + z), crop_select_sse2(t, n, s, e, w));
+        }
+    }
+}
+#endif
+
+#ifdef HAVE_AVX2
+__attribute__((target("avx2")))
+static void be16_avx2(uint16_t *restrict dst, const uint8_t *restrict src, size_t count) {
+    const __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                          1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (src + i * 2));
+        _mm256_storeu_si256((__m256i*) (dst + i), _mm256_shuffle_epi8(v, swap));
+    }
+    be16_scalar(dst + i, src + i * 2, count - i);
+}
+
+__attribute__((target("avx2")))
+static void be32_avx2(uint32_t *restrict dst, const uint8_t *restrict src, size_t count) {
+    const __m256i swap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (src + i * 4));
+        _mm256_storeu_si256((__m256i*) (dst + i), _mm256_shuffle_epi8(v, swap));
+    }
+    be32_scalar(dst + i, src + i * 4, count - i);
+}
+
+/*
+ * eight records per step, two per 128 bit lane picked out of two overlapping loads:
+ * the first holds all of a lane's first record, the second (4 bytes on) all of its
+ * second record. the tiles are then split into fields like the sse2 kernel does.
+ */
+__attribute__((target("avx2")))
+static void tiles_avx2(const struct TileFields *restrict dst, const uint8_t *restrict src, size_t count, bool underground) {
+    const char z = -128; /* shuffle index that clears the byte */
+    const __m256i first = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 9, 8, z, z, z, z, z, z, z, z,
+                                           0, 1, 2, 3, 4, 5, 9, 8, z, z, z, z, z, z, z, z);
+    const __m256i second = _mm256_setr_epi8(z, z, z, z, z, z, z, z, 6, 7, 8, 9, 10, 11, 15, 14,
+                                            z, z, z, z, z, z, z, z, 6, 7, 8, 9, 10, 11, 15, 14);
+    __m256i quads[2];
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8, src += TILE_RECORD_SIZE * 8) {
+        for (unsigned q = 0; q < 2; q++) {
+            const uint8_t *rec = src + q * TILE_RECORD_SIZE * 4;
+            __m256i a = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) rec)),
+                                                _mm_loadu_si128((const __m128i*) (rec + 20)), 1);
+            __m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) (rec + 4))),
+                                                _mm_loadu_si128((const __m128i*) (rec + 24)), 1);
+            quads[q] = _mm256_or_si256(_mm256_shuffle_epi8(a, first), _mm256_shuffle_epi8(b, second));
+        }
+        tiles_store_sse2(dst, i, _mm256_castsi256_si128(quads[0]), _mm256_extracti128_si256(quads[0], 1),
+                         _mm256_castsi256_si128(quads[1]), _mm256_extracti128_si256(quads[1], 1), underground);
+    }
+    struct TileFields rest = {
+        dst->height + i, dst->texture + i, dst->color + i, dst->roof + i,
+        dst->wall_east + i, dst->wall_north + i, dst->wall_diag + i
+    };
+    tiles_scalar(&rest, src, count - i, underground);
+}
+
+static bool avx2_supported(void) {
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#ifdef HAVE_NEON
+static void be16_neon(uint16_t *restrict dst, const uint8_t *restrict src, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        vst1q_u8((uint8_t*) (dst + i), vrev16q_u8(vld1q_u8(src + i * 2)));
+    }
+    be16_scalar(dst + i, src + i * 2, count - i);
+}
+
+static void be32_neon(uint32_t *restrict dst, const uint8_t *restrict src, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u8((uint8_t*) (dst + i), vrev32q_u8(vld1q_u8(src + i * 4)));
+    }
+    be32_scalar(dst + i, src + i * 4, count - i);
+}
+
+/* eight records per step, paired up as in the avx2 kernel and split into fields as in the sse2 one */
+static void tiles_neon(const struct TileFields *restrict dst, const uint8_t *restrict src, size_t count, bool underground) {
+    static const uint8_t first_index[16] = { 0, 1, 2, 3, 4, 5, 9, 8, 255, 255, 255, 255, 255, 255, 255, 255 };
+    static const uint8_t second_index[16] = { 255, 255, 255, 255, 255, 255, 255, 255, 6, 7, 8, 9, 10, 11, 15, 14 };
+    const uint8x16_t first = vld1q_u8(first_index);
+    const uint8x16_t second = vld1q_u8(second_index);
+    uint8x16_t pairs[4];
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8, src += TILE_RECORD_SIZE * 8) {
+        for (unsigned p = 0; p < 4; p++) {
+            const uint8_t *rec = src + p * TILE_RECORD_SIZE * 2;
+            pairs[p] = vorrq_u8(vqtbl1q_u8(vld1q_u8(rec), first), vqtbl1q_u8(vld1q_u8(rec + 4), second));
+        }
+
+        uint8x16_t ab_lo = vzip1q_u8(pairs[0], pairs[1]), ab_hi = vzip2q_u8(pairs[0], pairs[1]);
+        uint8x16_t cd_lo = vzip1q_u8(pairs[2], pairs[3]), cd_hi = vzip2q_u8(pairs[2], pairs[3]);
+        uint32x4_t first_lo = vreinterpretq_u32_u8(vzip1q_u8(ab_lo, ab_hi));
+        uint32x4_t first_hi = vreinterpretq_u32_u8(vzip2q_u8(ab_lo, ab_hi));
+        uint32x4_t last_lo = vreinterpretq_u32_u8(vzip1q_u8(cd_lo, cd_hi));
+        uint32x4_t last_hi = vreinterpretq_u32_u8(vzip2q_u8(cd_lo, cd_hi));
+
+        uint8x16_t height_color = vreinterpretq_u8_u32(vzip1q_u32(first_lo, last_lo));
+        uint8x16_t texture_roof = vreinterpretq_u8_u32(vzip2q_u32(first_lo, last_lo));
+        uint8x16_t walls = vreinterpretq_u8_u32(vzip1q_u32(first_hi, last_hi));
+        uint8x16_t diag = vreinterpretq_u8_u32(vzip2q_u32(first_hi, last_hi));
+
+        vst1_u8(dst->height + i, underground ? vdup_n_u8(0) : vget_low_u8(height_color));
+        vst1_u8(dst->color + i, vget_high_u8(height_color));
+        vst1_u8(dst->texture + i, vget_low_u8(texture_roof));
+        vst1_u8(dst->roof + i, vget_high_u8(texture_roof));
+        vst1_u8(dst->wall_east + i, vget_low_u8(walls));
+        vst1_u8(dst->wall_north + i, vget_high_u8(walls));
+        vst1q_u8((uint8_t*) (dst->wall_diag + i), vzip1q_u8(diag, vextq_u8(diag, diag, 8)));
+    }
+    struct TileFields rest = {
+        dst->height + i, dst->texture + i, dst->color + i, dst->roof + i,
+        dst->wall_east + i, dst->wall_north + i, dst->wall_diag + i
+    };
+    tiles_scalar(&rest, src, count - i, underground);
+}
+
+/* the same bit logic as crop_select_sse2() */
+static void crops_neon(uint8_t *restrict dst, const uint8_t *restrict texture) {
+    const uint8x16_t none = vdupq_n_u8(0);
+    for (unsigned x = 0; x < 48; x++) {
+        for (unsigned z = 0; z < 48; z += 16) {
+            const uint8_t *tile = texture + x * 48 + z;
+            uint8x16_t v = vld1q_u8(tile);
+            uint8x16_t t = vtstq_u8(v, v);
+            uint8x16_t n = z == 0 ? vextq_u8(none, t, 15) : vld1q_u8(tile - 1);
+            uint8x16_t s = z == 32 ? vextq_u8(t, none, 1) : vld1q_u8(tile + 1);
+            uint8x16_t e = x > 0 ? vld1q_u8(tile - 48) : none;
+            uint8x16_t w = x < 47 ? vld1q_u8(tile + 48) : none;
+            n = vtstq_u8(n, n), s = vtstq_u8(s, s), e = vtstq_u8(e, e), w = vtstq_u8(w, w);
+
+            uint8x16_t top_right = vbicq_u8(t, vorrq_u8(n, e));
+            uint8x16_t top_left = vbicq_u8(vandq_u8(t, vandq_u8(s, e)), vorrq_u8(n, w));
+            uint8x16_t bottom_right = vbicq_u8(vandq_u8(t, vandq_u8(n, w)), vorrq_u8(s, e));
+            uint8x16_t bottom_left = vbicq_u8(vandq_u8(t, vorrq_u8(n, e)), vorrq_u8(s, w));
+            uint8x16_t style = vorrq_u8(vorrq_u8(vandq_u8(top_right, vdupq_n_u8(CROP_TOP_RIGHT)),
+                                                 vandq_u8(top_left, vdupq_n_u8(CROP_TOP_LEFT))),
+                                        vorrq_u8(vandq_u8(bottom_right, vdupq_n_u8(CROP_BOTTOM_RIGHT)),
+                                                 vandq_u8(bottom_left, vdupq_n_u8(CROP_BOTTOM_LEFT))));
+            vst1q_u8(dst + x * 48 + z, style);
+        }
+    }
+}
+#endif
+
+/* slowest first, avx2 has no use for wider vectors on a 48 tile row and keeps the sse2 crops */
+static const struct DecodeKernels kernels[] = {
+    { "scalar", NULL, be16_scalar, be32_scalar, tiles_scalar, crops_scalar },
+    #ifdef HAVE_SSE2
+    { "sse2", NULL, be16_sse2, be32_sse2, tiles_sse2, crops_sse2 },
+    #endif
+    #ifdef HAVE_AVX2
+    { "avx2", avx2_supported, be16_avx2, be32_avx2, tiles_avx2, crops_sse2 },
+    #endif
+    #ifdef HAVE_NEON
+    { "neon", NULL, be16_neon, be32_neon, tiles_neon, crops_neon },
+    #endif
+};
+
+#define NUM_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+/* loader threads may race to pick, they all pick the same */
+static _Atomic(const struct DecodeKernels*) active;
+
+static const struct DecodeKernels* decode_active(void) {
+    const struct DecodeKernels *best = atomic_load(&active);
+    if (!best) {
+        best = &kernels[0];
+        for (unsigned i = 1; i < NUM_KERNELS; i++) {
+            if (decode_supported(&kernels[i])) best = &kernels[i];
+        }
+        atomic_store(&active, best);
+    }
+    return best;
+}
+
+/* every kernel set built in, including any the cpu doesn't support */
+const struct DecodeKernels* decode_kernels(unsigned *count) {
+    *count = NUM_KERNELS;
+    return kernels;
+}
+
+bool decode_supported(const struct DecodeKernels *set) {
+    return !set->supported || set->supported();
+}
+
+void decode_be16(uint16_t *dst, const uint8_t *src, size_t count) {
+    decode_active()->be16(dst, src, count);
+}
+
+void decode_be32(uint32_t *dst, const uint8_t *src, size_t count) {
+    decode_active()->be32(dst, src, count);
+}
+
+void decode_tiles(const struct TileFields *dst, const uint8_t *src, size_t count, bool underground) {
+    decode_active()->tiles(dst, src, count, underground);
+}
+
+void decode_crops(uint8_t *dst, const uint8_t *texture) {
+    decode_active()->crops(dst, texture);
+}
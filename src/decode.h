@@ -0,0 +1,36 @@
+#ifndef DECODE_H_INCLUDED
+#define DECODE_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sector.h"
+
+/* where decoded tile records go, one array per field (see struct SectorTiles) */
+struct TileFields {
+    uint8_t *height, *texture, *color, *roof, *wall_east, *wall_north;
+    uint16_t *wall_diag;
+};
+
+/* bulk decoders for the big endian game files, one set per instruction set */
+struct DecodeKernels {
+    const char *name;
+    bool (*supported)(void); /* NULL when the instruction set is always there */
+    void (*be16)(uint16_t *dst, const uint8_t *src, size_t count);
+    void (*be32)(uint32_t *dst, const uint8_t *src, size_t count);
+    /* splits tile records into their fields, the 32 bit diagonal wall keeps its low 16 bits */
+    void (*tiles)(const struct TileFields *dst, const uint8_t *src, size_t count, bool underground);
+    /* crop style (enum CropStyle) of each tile of a 48x48 plane from its texture and its neighbours' */
+    void (*crops)(uint8_t *dst, const uint8_t *texture);
+};
+
+const struct DecodeKernels* decode_kernels(unsigned *count);
+bool decode_supported(const struct DecodeKernels *set);
+
+/* run the fastest kernels the cpu supports, picked on first use */
+void decode_be16(uint16_t *dst, const uint8_t *src, size_t count);
+void decode_be32(uint32_t *dst, const uint8_t *src, size_t count);
+void decode_tiles(const struct TileFields *dst, const uint8_t *src, size_t count, bool underground);
+void decode_crops(uint8_t *dst, const uint8_t *texture);
+
+#endif // DECODE_H_INCLUDED
@@ -0,0 +1,46 @@
+#include <math.h>
+#include "frustum.h"
+#include "matrix.h"
+
+/* matrices are column major, as returned by glGetFloatv */
+void frustum_extract(struct Frustum *frustum, const float *projection, const float *modelview) {
+    float m[16];
+
+    /* clip = projection * modelview */
+    mat4_multiply(m, projection, modelview);
+
+    /* each plane is the w row plus or minus one of the x, y and z rows */
+    for (unsigned i = 0; i < 6; i++) {
+        unsigned row = i / 2;
+        float sign = i % 2 ? -1 : 1;
+        float *plane = frustum->planes[i];
+
+        for (unsigned col = 0; col < 4; col++) {
+            plane[col] = m[col * 4 + 3] + sign * m[col * 4 + row];
+        }
+
+        float len = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (len > 0) {
+            for (unsigned col = 0; col < 4; col++) {
+                plane[col] /= len;
+            }
+        }
+    }
+}
+
+/* false only if the box is entirely outside one of the planes */
+bool frustum_test_box(const struct Frustum *frustum, const float *min, const float *max) {
+    for (unsigned i = 0; i < 6; i++) {
+        const float *plane = frustum->planes[i];
+
+        /* the corner furthest along the plane normal */
+        float x = plane[0] >= 0 ? max[0] : min[0];
+        float y = plane[1] >= 0 ? max[1] : min[1];
+        float z = plane[2] >= 0 ? max[2] : min[2];
+
+        if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,13 @@
+#ifndef FRUSTUM_H_INCLUDED
+#define FRUSTUM_H_INCLUDED
+
+#include <stdbool.h>
+
+struct Frustum {
+    float planes[6][4]; /* a*x + b*y + c*z + d >= 0 inside, normalized */
+};
+
+void frustum_extract(struct Frustum *frustum, const float *projection, const float *modelview);
+bool frustum_test_box(const struct Frustum *frustum, const float *min, const float *max);
+
+#endif // FRUSTUM_H_INCLUDED
@@ -0,0 +1,112 @@
+/*
+ * fans a batch of independent items out over one thread per core. the items are
+ * a shared queue that every thread takes the next index from with an atomic
+ * increment, so a slow item doesn't hold up the others. jobs_run() returns once
+ * the whole batch is done, jobs_start() leaves it running in the background
+ * until jobs_wait(). without threads (the web build) a batch simply loops.
+ */
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#elif !defined(EMSCRIPTEN)
+    #include <unistd.h>
+#endif
+
+#ifndef EMSCRIPTEN
+    #include <pthread.h>
+#endif
+
+#include "jobs.h"
+#include "util.h"
+
+struct JobBatch {
+    JobFunc func;
+    void *data;
+    unsigned count;
+    _Atomic unsigned next;
+    _Atomic unsigned done; /* items finished, their results are visible once this reaches count */
+    #ifndef EMSCRIPTEN
+    pthread_t workers[JOBS_MAX_THREADS];
+    unsigned num_workers;
+    #endif
+};
+
+static void batch_drain(struct JobBatch *batch) {
+    unsigned index;
+    while ((index = atomic_fetch_add(&batch->next, 1)) < batch->count) {
+        batch->func(batch->data, index);
+        atomic_fetch_add(&batch->done, 1);
+    }
+}
+
+#ifndef EMSCRIPTEN
+static void* jobs_worker(void *arg) {
+    batch_drain(arg);
+    return NULL;
+}
+#endif
+
+static struct JobBatch* batch_start(JobFunc func, void *data, unsigned count, unsigned threads) {
+    struct JobBatch *batch = xmalloc(sizeof(struct JobBatch));
+    batch->func = func;
+    batch->data = data;
+    batch->count = count;
+    atomic_init(&batch->next, 0);
+    atomic_init(&batch->done, 0);
+
+    #ifndef EMSCRIPTEN
+    batch->num_workers = threads < count ? threads : count;
+    for (unsigned i = 0; i < batch->num_workers; i++) {
+        if (pthread_create(&batch->workers[i], NULL, jobs_worker, batch) != 0) {
+            ABORT("cannot start %s thread", "jobs");
+        }
+    }
+    #else
+    batch_drain(batch);
+    #endif
+
+    return batch;
+}
+
+unsigned jobs_threads(void) {
+    long cores = 1;
+    #ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    cores = info.dwNumberOfProcessors;
+    #elif !defined(EMSCRIPTEN)
+    cores = sysconf(_SC_NPROCESSORS_ONLN);
+    #endif
+
+    if (cores < 1) return 1;
+    return cores > JOBS_MAX_THREADS ? JOBS_MAX_THREADS : (unsigned) cores;
+}
+
+/* runs the whole batch before returning, the calling thread takes items too */
+void jobs_run(JobFunc func, void *data, unsigned count) {
+    jobs_wait(batch_start(func, data, count, jobs_threads() - 1));
+}
+
+/* starts the batch on background threads, data must stay valid until jobs_wait() */
+struct JobBatch* jobs_start(JobFunc func, void *data, unsigned count) {
+    return batch_start(func, data, count, jobs_threads());
+}
+
+bool jobs_finished(struct JobBatch *batch) {
+    return atomic_load(&batch->done) == batch->count;
+}
+
+/* helps with whatever is left of the batch, then releases it */
+void jobs_wait(struct JobBatch *batch) {
+    batch_drain(batch);
+
+    #ifndef EMSCRIPTEN
+    for (unsigned i = 0; i < batch->num_workers; i++) {
+        pthread_join(batch->workers[i], NULL);
+    }
+    #endif
+
+    free(batch);
+}
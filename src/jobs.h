@@ -0,0 +1,19 @@
+#ifndef JOBS_H_INCLUDED
+#define JOBS_H_INCLUDED
+
+#include <stdbool.h>
+
+#define JOBS_MAX_THREADS 32
+
+/* runs one item of a batch, items are independent so they may run in any order and on any thread */
+typedef void (*JobFunc)(void *data, unsigned index);
+
+struct JobBatch;
+
+unsigned jobs_threads(void);
+void jobs_run(JobFunc func, void *data, unsigned count);
+struct JobBatch* jobs_start(JobFunc func, void *data, unsigned count);
+bool jobs_finished(struct JobBatch *batch);
+void jobs_wait(struct JobBatch *batch);
+
+#endif // JOBS_H_INCLUDED
@@ -0,0 +1,78 @@
+/*
+ * the matrix stack of the fixed-function pipeline on the CPU, so the scene can
+ * be transformed the same way by the GL and the software renderer.
+ */
+#include <math.h>
+#include <string.h>
+#include "matrix.h"
+
+#ifndef M_PI
+    #define M_PI 3.14159265358979323846
+#endif
+
+void mat4_identity(float *m) {
+    memset(m, 0, 16 * sizeof(float));
+    m[0] = m[5] = m[10] = m[15] = 1;
+}
+
+/* out = a * b, out may alias either */
+void mat4_multiply(float *out, const float *a, const float *b) {
+    float m[16];
+
+    for (unsigned col = 0; col < 4; col++) {
+        for (unsigned row = 0; row < 4; row++) {
+            m[col * 4 + row] = a[0 * 4 + row] * b[col * 4 + 0]
+                             + a[1 * 4 + row] * b[col * 4 + 1]
+                             + a[2 * 4 + row] * b[col * 4 + 2]
+                             + a[3 * 4 + row] * b[col * 4 + 3];
+        }
+    }
+    memcpy(out, m, sizeof(m));
+}
+
+/* glTranslatef */
+void mat4_translate(float *m, float x, float y, float z) {
+    for (unsigned row = 0; row < 4; row++) {
+        m[12 + row] += m[row] * x + m[4 + row] * y + m[8 + row] * z;
+    }
+}
+
+/* glRotatef, angle in degrees about the axis (x, y, z) */
+void mat4_rotate(float *m, float angle, float x, float y, float z) {
+    float len = sqrtf(x * x + y * y + z * z);
+    if (len == 0) return;
+    x /= len; y /= len; z /= len;
+
+    float rad = angle * (float) M_PI / 180;
+    float c = cosf(rad), s = sinf(rad), t = 1 - c;
+    float r[16] = {
+        x * x * t + c,     y * x * t + z * s, x * z * t - y * s, 0,
+        x * y * t - z * s, y * y * t + c,     y * z * t + x * s, 0,
+        x * z * t + y * s, y * z * t - x * s, z * z * t + c,     0,
+        0,                 0,                 0,                 1
+    };
+    mat4_multiply(m, m, r);
+}
+
+/* gluPerspective */
+void mat4_perspective(float *m, float fovy, float aspect, float near, float far) {
+    float f = 1 / tanf(fovy * (float) M_PI / 360);
+
+    memset(m, 0, 16 * sizeof(float));
+    m[0] = f / aspect;
+    m[5] = f;
+    m[10] = (far + near) / (near - far);
+    m[11] = -1;
+    m[14] = 2 * far * near / (near - far);
+}
+
+/* glOrtho */
+void mat4_ortho(float *m, float left, float right, float bottom, float top, float near, float far) {
+    mat4_identity(m);
+    m[0] = 2 / (right - left);
+    m[5] = 2 / (top - bottom);
+    m[10] = -2 / (far - near);
+    m[12] = -(right + left) / (right - left);
+    m[13] = -(top + bottom) / (top - bottom);
+    m[14] = -(far + near) / (far - near);
+}
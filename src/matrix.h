@@ -0,0 +1,12 @@
+#ifndef MATRIX_H_INCLUDED
+#define MATRIX_H_INCLUDED
+
+/* 4x4 matrices, column major as in GL. the transforms post-multiply like their GL counterparts */
+void mat4_identity(float *m);
+void mat4_multiply(float *out, const float *a, const float *b);
+void mat4_translate(float *m, float x, float y, float z);
+void mat4_rotate(float *m, float angle, float x, float y, float z);
+void mat4_perspective(float *m, float fovy, float aspect, float near, float far);
+void mat4_ortho(float *m, float left, float right, float bottom, float top, float near, float far);
+
+#endif // MATRIX_H_INCLUDED
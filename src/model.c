@@ -1,117 +1,169 @@
+#include <math.h>
 #include <stdlib.h>
+#include "decode.h"
 #include "model.h"
 #include "util.h"
 
 const uint32_t USE_GOURAD_SHADING = 0xbc614e; /* 12345678 */
 
-void model_load(struct Model *model, char *data) {
-    unsigned offset = 0;
-
-    uint16_t vert_count = get_uint16(data, offset);
-    offset += 2;
-    
-    uint16_t face_count = get_uint16(data, offset);
-    offset += 2;
-
-    model->vertices_x =        (int16_t*)  xmalloc(vert_count * sizeof(int16_t));
-    model->vertices_y =        (int16_t*)  xmalloc(vert_count * sizeof(int16_t));
-    model->vertices_z =        (int16_t*)  xmalloc(vert_count * sizeof(int16_t));
-    model->face_vertex_count = (uint8_t*)  xmalloc(face_count * sizeof(uint8_t));
-    model->face_vertices =     (int16_t**) xmalloc(face_count * sizeof(int16_t*));
-    model->face_fill_back =    (int32_t*)  xmalloc(face_count * sizeof(int32_t));
-    model->face_fill_front =   (int32_t*)  xmalloc(face_count * sizeof(int32_t));
-    model->face_gouraud =      (int32_t*)  xmalloc(face_count * sizeof(int32_t));
-
-    unsigned i;
-
-    for (i = 0; i < vert_count; i++) {
-        model->vertices_x[i] = get_int16(data, offset);
-        offset += 2;
-    }
+/* a face color, 0x7FFF marks a gouraud shaded one */
+static int32_t model_fill(const uint8_t *bytes) {
+    int16_t fill = (int16_t) (bytes[0] << 8 | bytes[1]);
+    return fill == 0x7FFF ? (int32_t) USE_GOURAD_SHADING : fill;
+}
 
-    for (i = 0; i < vert_count; i++) {
-        model->vertices_y[i] = get_int16(data, offset);
-        offset += 2;
+/*
+ * decodes an .ob3 in place, typically straight from a mapped file. the face sizes
+ * are summed up first so that the whole model fits one allocation, widest element
+ * type first to keep every array aligned. the big endian vertex and index arrays
+ * are byte swapped in bulk. false if the data is truncated or a face index is out of range.
+ */
+bool model_load(struct Model *model, const uint8_t *data, size_t length) {
+    if (length < 4) {
+        return false;
     }
 
-    for (i = 0; i < vert_count; i++) {
-        model->vertices_z[i] = get_int16(data, offset);
-        offset += 2;
-    }
+    uint16_t vert_count = data[0] << 8 | data[1];
+    uint16_t face_count = data[2] << 8 | data[3];
 
-    model->vertex_count = vert_count;
+    const uint8_t *coords      = data + 4;
+    const uint8_t *face_sizes  = coords + vert_count * 3 * 2;
+    const uint8_t *fill_back   = face_sizes + face_count;
+    const uint8_t *fill_front  = fill_back + face_count * 2;
+    const uint8_t *gouraud     = fill_front + face_count * 2;
+    const uint8_t *indices     = gouraud + face_count;
 
-    for (i = 0; i < face_count; i++) {
-        model->face_vertex_count[i] = get_ubyte(data[offset++]);
+    if ((size_t) (indices - data) > length) {
+        return false;
     }
 
-    for (i = 0; i < face_count; i++) {
-        model->face_fill_back[i] = get_int16(data, offset);
-        offset += 2;
-        if (model->face_fill_back[i] == 0x7FFF) {
-            model->face_fill_back[i] = USE_GOURAD_SHADING;
-        }
+    uint32_t index_count = 0;
+    for (unsigned i = 0; i < face_count; i++) {
+        index_count += face_sizes[i];
     }
 
-    for (i = 0; i < face_count; i++) {
-        model->face_fill_front[i] = get_int16(data, offset);
-        offset += 2;
-        if (model->face_fill_front[i] == 0x7FFF) {
-            model->face_fill_front[i] = USE_GOURAD_SHADING;
-        }
+    unsigned index_size = vert_count <= 0xFF ? 1 : 2;
+    if ((size_t) (indices - data) + (size_t) index_count * index_size > length) {
+        return false;
     }
 
-    for (i = 0; i < face_count; i++) {
-        uint8_t n = get_ubyte(data[offset++]);
-        model->face_gouraud[i] = n ? USE_GOURAD_SHADING : 0;
+    size_t size = face_count * 3 * sizeof(int32_t)
+                + (face_count + 1) * sizeof(uint32_t)
+                + vert_count * 3 * sizeof(int16_t)
+                + index_count * sizeof(uint16_t);
+    char *arena = xmalloc(size);
+    model->arena = arena;
+
+    model->face_fill_back =    (int32_t*)  arena;
+    model->face_fill_front =   model->face_fill_back + face_count;
+    model->face_gouraud =      model->face_fill_front + face_count;
+    model->face_offsets =      (uint32_t*) (model->face_gouraud + face_count);
+    model->vertices_x =        (int16_t*)  (model->face_offsets + face_count + 1);
+    model->vertices_y =        model->vertices_x + vert_count;
+    model->vertices_z =        model->vertices_y + vert_count;
+    model->face_indices =      (uint16_t*) (model->vertices_z + vert_count);
+
+    /* x, y and z are stored back to back just like in the arena */
+    decode_be16((uint16_t*) model->vertices_x, coords, vert_count * 3);
+    model->vertex_count = vert_count;
+
+    model->face_offsets[0] = 0;
+    for (unsigned i = 0; i < face_count; i++) {
+        model->face_offsets[i + 1] = model->face_offsets[i] + face_sizes[i];
+        model->face_fill_back[i] = model_fill(fill_back + i * 2);
+        model->face_fill_front[i] = model_fill(fill_front + i * 2);
+        model->face_gouraud[i] = gouraud[i] ? USE_GOURAD_SHADING : 0;
     }
 
-    for (i = 0; i < face_count; i++) {
-        model->face_vertices[i] = (int16_t*) xmalloc(model->face_vertex_count[i] * sizeof(int16_t));
-        for (unsigned fv = 0; fv < model->face_vertex_count[i]; fv++) {
-            if (vert_count <= 0xFF) {
-                model->face_vertices[i][fv] = get_ubyte(data[offset]);
-                offset++;
-            } else {
-                model->face_vertices[i][fv] = get_uint16(data, offset);
-                offset += 2;
-            }
+    /* the faces are stored back to back, so their indices are one run */
+    if (index_size == 2) {
+        decode_be16(model->face_indices, indices, index_count);
+    } else {
+        for (uint32_t i = 0; i < index_count; i++) {
+            model->face_indices[i] = indices[i];
+        }
+    }
+
+    /* a face pointing past the vertices would be read out of the arena when baking */
+    for (uint32_t i = 0; i < index_count; i++) {
+        if (model->face_indices[i] >= vert_count) {
+            free(model->arena);
+            model->arena = NULL;
+            return false;
         }
     }
 
     model->face_count = face_count;
 
     model->loaded = true;
+    return true;
 }
 
-void model_cleanup(struct Model *model) {
-    free(model->vertices_x);
-    free(model->vertices_y);
-    free(model->vertices_z);
-    free(model->face_vertex_count);
+/*
+ * triangulates the faces into the model's mesh, in model units divided by scale.
+ * polygons become fans (they are convex), which also covers emscripten lacking
+ * GL_POLYGON. without an atlas the textured faces aren't drawn, and like the old
+ * immediate mode path the mesh ends at the first of them.
+ */
+void model_bake(struct Model *model, const struct TextureAtlas *atlas, float scale) {
+    static const uint8_t uv[4][2] = { { 1, 0 }, { 0, 0 }, { 0, 1 }, { 1, 1 } };
+    unsigned count = 0;
 
     for (unsigned i = 0; i < model->face_count; i++) {
-        free(model->face_vertices[i]);
+        unsigned n = model->face_offsets[i + 1] - model->face_offsets[i];
+        if (n >= 3) count += (n - 2) * 3;
     }
-    free(model->face_vertices);
 
-    free(model->face_fill_back);
-    free(model->face_fill_front);
-    free(model->face_gouraud);
-}
+    free(model->mesh);
+    model->mesh = count ? xmalloc(count * sizeof(struct RenderVertex)) : NULL;
+    model->mesh_count = 0;
+    model->radius = model->min_y = model->max_y = 0;
 
-uint8_t get_ubyte(char byte) {
-    return byte & 0xFF;
-}
+    for (unsigned i = 0; i < model->face_count; i++) {
+        int32_t front = model->face_fill_front[i], back = model->face_fill_back[i];
+        struct RenderVertex corner = { 0, 0, 0, 0, 0, 255, 255, 255, 255 };
+        const struct AtlasRegion *region = NULL;
+
+        /* non-textured faces */
+        if (front < 0 || back < 0) {
+            int packed_col = front < 0 ? front : back;
+            corner.r = (~packed_col >> 10 & 31) * 8;
+            corner.g = (~packed_col >> 5  & 31) * 8;
+            corner.b = (~packed_col       & 31) * 8;
+        /* textured faces */
+        } else if (atlas) {
+            int id = front > 0 ? front : back;
+            region = id < ATLAS_MAX_IMAGES ? &atlas->regions[id] : &atlas->white;
+        } else {
+            break;
+        }
 
-uint16_t get_uint16(char *bytes, unsigned start) {
-    return (get_ubyte(bytes[start]) << 8) + get_ubyte(bytes[start + 1]);
+        const uint16_t *face = model->face_indices + model->face_offsets[i];
+        unsigned n = model->face_offsets[i + 1] - model->face_offsets[i];
+        for (unsigned t = 1; t + 1 < n; t++) {
+            unsigned fan[3] = { 0, t, t + 1 };
+            for (unsigned k = 0; k < 3; k++) {
+                unsigned fv = fan[k];
+                uint16_t v = face[fv];
+                struct RenderVertex vertex = corner;
+                vertex.x =  model->vertices_x[v] / scale;
+                vertex.y =  model->vertices_y[v] / scale;
+                vertex.z = -model->vertices_z[v] / scale;
+                if (region) {
+                    atlas_uv(region, uv[fv < 3 ? fv : 3][0], uv[fv < 3 ? fv : 3][1], &vertex.u, &vertex.v);
+                }
+                model->mesh[model->mesh_count++] = vertex;
+
+                float radius = sqrtf(vertex.x * vertex.x + vertex.z * vertex.z);
+                if (radius > model->radius) model->radius = radius;
+                if (vertex.y < model->min_y) model->min_y = vertex.y;
+                if (vertex.y > model->max_y) model->max_y = vertex.y;
+            }
+        }
+    }
 }
 
-int16_t get_int16(char *bytes, unsigned start) {
-    int i = get_ubyte(bytes[start]) * 0x100 + get_ubyte(bytes[start + 1]);
-    if (i > 0x7FFF) {
-        i -= 0x10000;
-    }
-    return i;
+void model_cleanup(struct Model *model) {
+    free(model->arena);
+    free(model->mesh);
 }
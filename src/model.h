@@ -2,31 +2,38 @@
 #define MODEL_H_INCLUDED
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "atlas.h"
+#include "render.h"
 
+/* every array below lives in one block, arena, allocated and freed as a whole */
 struct Model {
+    void *arena;
+
     uint16_t vertex_count;
     int16_t *vertices_x;
     int16_t *vertices_y;
     int16_t *vertices_z;
     uint16_t face_count;
-    uint8_t *face_vertex_count;
-    int16_t **face_vertices;
+    uint32_t *face_offsets;   /* face i uses face_indices[face_offsets[i]] up to face_offsets[i + 1] */
+    uint16_t *face_indices;
 
     /* these can be 16 bits once the flag value for gourad shading is changed */
     int32_t *face_fill_back;
     int32_t *face_fill_front;
     int32_t *face_gouraud;
 
-    uint8_t dir;
-    uint8_t width, height;
+    /* faces triangulated once by model_bake(), drawn with a single call per placement */
+    struct RenderVertex *mesh;
+    uint32_t mesh_count;
+    float radius, min_y, max_y; /* extent of the mesh around its y axis, whichever way it is turned */
+
     bool loaded;
 };
 
-void model_load(struct Model *model, char *data);
+bool model_load(struct Model *model, const uint8_t *data, size_t length);
+void model_bake(struct Model *model, const struct TextureAtlas *atlas, float scale);
 void model_cleanup(struct Model *model);
-uint8_t get_ubyte(char byte);
-uint16_t get_uint16(char *bytes, unsigned start);
-int16_t get_int16(char *bytes, unsigned start);
 
 #endif // MODEL_H_INCLUDED
@@ -0,0 +1,205 @@
+/*
+ * model placements bucketed by sector. the placements are reordered once so that
+ * every sector owns a contiguous slice (sorted by plane, sector and then tile),
+ * which turns the per-sector lookup into two array reads.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "placement.h"
+#include "util.h"
+
+static struct ModelLoc *placements;
+static uint32_t bucket_start[PLACEMENT_BUCKETS + 1];
+
+/* parses the placements out of model_locs.csv, returns how many were read */
+unsigned placement_load_csv(const char *fname, struct ModelLoc *locs, unsigned max) {
+    FILE* fp;
+    char* line = NULL;
+    size_t len = 0;
+
+    fp = fopen(fname, "r");
+    if (fp == NULL) {
+        ABORT("cannot open file: %s", fname);
+    }
+
+    unsigned n = 0;
+
+    while (readline(&line, &len, fp) != EOF) {
+        char** tokens;
+
+        if (n == max) {
+            ABORT("more than %u placements: %s", max, fname);
+        }
+
+        tokens = split(line, ',');
+
+        if (tokens) {
+            locs[n].x      = atoi(*(tokens + 0));
+            locs[n].y      = atoi(*(tokens + 1));
+            locs[n].dir    = atoi(*(tokens + 2));
+            locs[n].width  = atoi(*(tokens + 3));
+            locs[n].height = atoi(*(tokens + 4));
+            locs[n].id     = atoi(*(tokens + 5));
+            char *name     =      *(tokens + 6);
+
+            /* strip the trailing new line character */
+            name[strcspn(name, "\r\n")] = '\0';
+            locs[n].name   = name;
+
+            for (unsigned i = 0; i < 6; i++) {
+                free(tokens[i]);
+            }
+
+            n++;
+            free(tokens);
+        }
+    }
+
+    fclose(fp);
+    if (line) {
+        free(line);
+    }
+
+    return n;
+}
+
+/* maps a table written by locpack, returns false if it cannot be opened */
+bool placement_table_open(struct PlacementTable *table, const char *fname) {
+    table->data = map_file(fname, &table->length);
+
+    if (!table->data) {
+        return false;
+    }
+
+    const uint8_t *header = table->data;
+
+    if (table->length < TABLE_HEADER_SIZE || memcmp(header, TABLE_MAGIC, 4) != 0) {
+        ABORT("not a placement table: %s", fname);
+    }
+
+    if (get_le16(header + 4) != TABLE_VERSION) {
+        ABORT("unsupported placement table version %u: %s", get_le16(header + 4), fname);
+    }
+
+    uint32_t count   = get_le32(header + 8);
+    uint32_t names   = get_le32(header + 12);
+    uint32_t strings = get_le32(header + 16);
+
+    if ((uint64_t) TABLE_HEADER_SIZE + (uint64_t) count * TABLE_RECORD_SIZE + (uint64_t) names * 4 + strings != table->length
+            || !strings || table->data[table->length - 1] != '\0') {
+        ABORT("corrupt placement table: %s", fname);
+    }
+
+    /* validate the names and records once up front so reading can trust them */
+    const uint8_t *offsets = header + TABLE_HEADER_SIZE + count * TABLE_RECORD_SIZE;
+    for (uint32_t i = 0; i < names; i++) {
+        if (get_le32(offsets + i * 4) >= strings) {
+            ABORT("corrupt placement table name %u: %s", i, fname);
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (get_le16(header + TABLE_HEADER_SIZE + i * TABLE_RECORD_SIZE + 10) >= names) {
+            ABORT("corrupt placement table record %u: %s", i, fname);
+        }
+    }
+
+    return true;
+}
+
+void placement_table_close(struct PlacementTable *table) {
+    unmap_file(table->data, table->length);
+    table->data = NULL;
+    table->length = 0;
+}
+
+/* decodes the records into locs, returns how many were read */
+unsigned placement_table_read(const struct PlacementTable *table, struct ModelLoc *locs, unsigned max) {
+    const uint8_t *header = table->data;
+    uint32_t count = get_le32(header + 8);
+    uint32_t names = get_le32(header + 12);
+    const uint8_t *record = header + TABLE_HEADER_SIZE;
+    const uint8_t *offsets = record + count * TABLE_RECORD_SIZE;
+    const char *strings = (const char*) offsets + names * 4;
+
+    if (count > max) {
+        ABORT("more than %u placements in the placement table", max);
+    }
+
+    for (uint32_t i = 0; i < count; i++, record += TABLE_RECORD_SIZE) {
+        locs[i].x      = get_le16(record);
+        locs[i].y      = get_le16(record + 2);
+        locs[i].dir    = record[4];
+        locs[i].width  = record[5];
+        locs[i].height = record[6];
+        locs[i].id     = get_le16(record + 8);
+        locs[i].name   = strings + get_le32(offsets + get_le16(record + 10) * 4);
+    }
+
+    return count;
+}
+
+static unsigned placement_bucket(struct ModelLoc *loc) {
+    struct Point3D p = coordinates_to_sector(loc->x, loc->y);
+    return sector_in_bounds(p.z, p.x, p.y) ? sector_index(p.z, p.x, p.y) : PLACEMENT_BUCKETS;
+}
+
+static unsigned placement_tile(struct ModelLoc *loc) {
+    return (loc->x % 48) * 48 + loc->y % 48;
+}
+
+/* stable counting sort of locs into out by key, returns how many keys were in range */
+static unsigned placement_sort(struct ModelLoc *locs, struct ModelLoc *out, unsigned count,
+                               unsigned (*key)(struct ModelLoc*), uint32_t *start, unsigned buckets) {
+    memset(start, 0, (buckets + 1) * sizeof(uint32_t));
+
+    for (unsigned i = 0; i < count; i++) {
+        unsigned k = key(&locs[i]);
+        if (k < buckets) start[k + 1]++;
+    }
+    for (unsigned k = 0; k < buckets; k++) {
+        start[k + 1] += start[k];
+    }
+
+    uint32_t *next = xmalloc(buckets * sizeof(uint32_t));
+    memcpy(next, start, buckets * sizeof(uint32_t));
+    for (unsigned i = 0; i < count; i++) {
+        unsigned k = key(&locs[i]);
+        if (k < buckets) out[next[k]++] = locs[i];
+    }
+    free(next);
+
+    return start[buckets];
+}
+
+/*
+ * reorders locs in place and indexes them, returns the number of placements kept
+ * (those outside the sector grid are dropped). placements sharing a tile keep
+ * their file order.
+ */
+unsigned placement_index_build(struct ModelLoc *locs, unsigned count) {
+    struct ModelLoc *temp = xmalloc(count * sizeof(struct ModelLoc));
+    uint32_t tile_start[48 * 48 + 1];
+
+    /* two stable passes: by tile within the sector, then by sector */
+    placement_sort(locs, temp, count, placement_tile, tile_start, 48 * 48);
+    unsigned kept = placement_sort(temp, locs, count, placement_bucket, bucket_start, PLACEMENT_BUCKETS);
+
+    free(temp);
+    placements = locs;
+
+    return kept;
+}
+
+/* returns the placements of the given sector, count receives their number */
+struct ModelLoc* placement_find(uint8_t plane, uint16_t x, uint16_t y, unsigned *count) {
+    if (!placements || !sector_in_bounds(plane, x, y)) {
+        *count = 0;
+        return NULL;
+    }
+
+    unsigned bucket = sector_index(plane, x, y);
+    *count = bucket_start[bucket + 1] - bucket_start[bucket];
+
+    return placements + bucket_start[bucket];
+}
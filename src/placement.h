@@ -0,0 +1,44 @@
+#ifndef PLACEMENT_H_INCLUDED
+#define PLACEMENT_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sector.h"
+
+#define PLACEMENT_BUCKETS (SECTOR_PLANES * SECTOR_COLS * SECTOR_ROWS)
+
+/*
+ * compiled placement table, model_locs.csv as fixed records (all fields little endian):
+ *   header   magic "RSCL", u16 version, u16 reserved, u32 count, u32 names, u32 strings size
+ *   records  count entries of { u16 x, u16 y, u8 dir, u8 width, u8 height, u8 reserved, u16 id, u16 name }
+ *   names    names entries of u32 offset into the strings, one per distinct model name
+ *   strings  the NUL terminated model names
+ */
+#define TABLE_MAGIC         "RSCL"
+#define TABLE_VERSION       1
+#define TABLE_HEADER_SIZE   20
+#define TABLE_RECORD_SIZE   12
+
+struct ModelLoc {
+    uint16_t x, y;
+    uint8_t dir;
+    uint8_t width, height;
+    uint16_t id;
+    const char *name;
+};
+
+/* a compiled placement table mapped into memory, placement names point into it */
+struct PlacementTable {
+    uint8_t *data;
+    size_t length;
+};
+
+unsigned placement_load_csv(const char *fname, struct ModelLoc *locs, unsigned max);
+bool placement_table_open(struct PlacementTable *table, const char *fname);
+void placement_table_close(struct PlacementTable *table);
+unsigned placement_table_read(const struct PlacementTable *table, struct ModelLoc *locs, unsigned max);
+unsigned placement_index_build(struct ModelLoc *locs, unsigned count);
+struct ModelLoc* placement_find(uint8_t plane, uint16_t x, uint16_t y, unsigned *count);
+
+#endif // PLACEMENT_H_INCLUDED
@@ -0,0 +1,285 @@
+/*
+ * background sector loading. a worker thread decodes the sectors around the
+ * view into a ring of sector buffers; each slot is handed between the worker
+ * and the main thread with a compare-and-swap on its state, so bringing a
+ * prefetched sector on screen only swaps a pointer.
+ */
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#ifndef EMSCRIPTEN
+    #include <errno.h>
+    #include <pthread.h>
+    #include <time.h>
+#endif
+
+#include "prefetch.h"
+#include "util.h"
+
+enum SlotState {
+    SLOT_FREE,
+    SLOT_LOADING, /* owned by the worker */
+    SLOT_READY,   /* holds a decoded sector nobody is using */
+    SLOT_ACTIVE   /* owned by the main thread (on screen) */
+};
+
+struct Slot {
+    _Atomic int state;
+    _Atomic uint32_t key;
+    struct SectorTiles *tiles;
+};
+
+#define SLOT_KEY(x, y)  (((uint32_t) (x) << 16) | (y))
+#define KEY_X(key)      ((key) >> 16)
+#define KEY_Y(key)      ((key) & 0xFFFF)
+
+#define WAIT_MS         4 /* longest the main thread waits on a sector the worker is loading */
+
+static struct Slot *slots;
+static unsigned num_slots;
+static SectorLoader load;
+static struct PrefetchStats stats;
+
+#ifndef EMSCRIPTEN
+static pthread_t worker;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t loaded = PTHREAD_COND_INITIALIZER; /* a slot the worker had finished loading */
+static uint32_t center;
+static unsigned reach;
+static _Atomic unsigned generation;
+static bool quit;
+#endif
+
+static bool slot_claim(struct Slot *slot, int from, int to) {
+    int expected = from;
+    return atomic_compare_exchange_strong(&slot->state, &expected, to);
+}
+
+static bool slot_has(struct Slot *slot, uint32_t key, int state) {
+    return atomic_load(&slot->state) == state && atomic_load(&slot->key) == key;
+}
+
+#ifndef EMSCRIPTEN
+static unsigned key_distance(uint32_t a, uint32_t b) {
+    unsigned dx = abs((int) KEY_X(a) - (int) KEY_X(b));
+    unsigned dy = abs((int) KEY_Y(a) - (int) KEY_Y(b));
+    return dx > dy ? dx : dy;
+}
+
+/* loads one sector around the current center unless it's already cached */
+static void prefetch_sector(uint32_t key, uint32_t from, unsigned radius) {
+    struct Slot *free_slot = NULL;
+    struct Slot *stale_slot = NULL;
+    unsigned stale_distance = radius;
+
+    for (unsigned i = 0; i < num_slots; i++) {
+        struct Slot *slot = &slots[i];
+        int state = atomic_load(&slot->state);
+
+        if (state == SLOT_FREE) {
+            if (!free_slot) free_slot = slot;
+            continue;
+        }
+
+        if (atomic_load(&slot->key) == key) {
+            return;
+        }
+
+        /* ready sectors outside the prefetch radius can be evicted, furthest first */
+        unsigned distance = key_distance(atomic_load(&slot->key), from);
+        if (state == SLOT_READY && distance > stale_distance) {
+            stale_slot = slot;
+            stale_distance = distance;
+        }
+    }
+
+    struct Slot *victim = free_slot ? free_slot : stale_slot;
+
+    /* the main thread may have taken the slot in the meantime */
+    if (!victim || !slot_claim(victim, free_slot ? SLOT_FREE : SLOT_READY, SLOT_LOADING)) {
+        return;
+    }
+
+    atomic_store(&victim->key, key);
+    atomic_store(&victim->state, load(victim->tiles, KEY_X(key), KEY_Y(key)) ? SLOT_READY : SLOT_FREE);
+
+    pthread_mutex_lock(&lock);
+    pthread_cond_broadcast(&loaded);
+    pthread_mutex_unlock(&lock);
+}
+
+/* waits up to WAIT_MS for the worker to finish loading a slot, true once it has */
+static bool slot_wait(struct Slot *slot, uint32_t key) {
+    struct timespec deadline;
+    timespec_get(&deadline, TIME_UTC);
+    deadline.tv_nsec += WAIT_MS * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&lock);
+    while (slot_has(slot, key, SLOT_LOADING)) {
+        if (pthread_cond_timedwait(&loaded, &lock, &deadline) == ETIMEDOUT) break;
+    }
+    pthread_mutex_unlock(&lock);
+
+    return !slot_has(slot, key, SLOT_LOADING);
+}
+
+static void* prefetch_worker(void *arg) {
+    unsigned seen = 0;
+
+    pthread_mutex_lock(&lock);
+    while (!quit) {
+        if (atomic_load(&generation) == seen) {
+            pthread_cond_wait(&wake, &lock);
+            continue;
+        }
+
+        seen = atomic_load(&generation);
+        uint32_t from = center;
+        int radius = reach;
+        pthread_mutex_unlock(&lock);
+
+        /* walk outwards ring by ring so the closest sectors arrive first */
+        for (int ring = 1; ring <= radius && atomic_load(&generation) == seen; ring++) {
+            for (int dx = -ring; dx <= ring; dx++) {
+                for (int dy = -ring; dy <= ring; dy++) {
+                    int x = KEY_X(from) + dx;
+                    int y = KEY_Y(from) + dy;
+                    if ((abs(dx) == ring || abs(dy) == ring) && x >= 0 && y >= 0) {
+                        prefetch_sector(SLOT_KEY(x, y), from, radius);
+                    }
+                }
+            }
+        }
+
+        pthread_mutex_lock(&lock);
+    }
+    pthread_mutex_unlock(&lock);
+
+    return arg;
+}
+#endif
+
+void prefetch_init(SectorLoader loader, unsigned slot_count) {
+    load = loader;
+    num_slots = slot_count;
+    slots = xmalloc(slot_count * sizeof(struct Slot));
+
+    for (unsigned i = 0; i < num_slots; i++) {
+        slots[i].tiles = xmalloc(sizeof(struct SectorTiles));
+        atomic_init(&slots[i].state, SLOT_FREE);
+        atomic_init(&slots[i].key, 0);
+    }
+
+    #ifndef EMSCRIPTEN
+    if (pthread_create(&worker, NULL, prefetch_worker, NULL) != 0) {
+        ABORT("cannot start %s thread", "prefetch");
+    }
+    #endif
+}
+
+void prefetch_shutdown(void) {
+    #ifndef EMSCRIPTEN
+    pthread_mutex_lock(&lock);
+    quit = true;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    pthread_join(worker, NULL);
+    #endif
+
+    for (unsigned i = 0; i < num_slots; i++) {
+        free(slots[i].tiles);
+    }
+    free(slots);
+}
+
+/*
+ * pins the given sector on screen and returns its tiles, NULL if it doesn't exist.
+ * it stays pinned (and is never evicted) until prefetch_release().
+ */
+struct SectorTiles* prefetch_acquire(uint16_t x, uint16_t y) {
+    uint32_t key = SLOT_KEY(x, y);
+    struct Slot *found = NULL;
+
+    for (unsigned i = 0; i < num_slots && !found; i++) {
+        struct Slot *slot = &slots[i];
+
+        #ifndef EMSCRIPTEN
+        /*
+         * the worker is on it right now, which is usually quicker than starting over.
+         * past WAIT_MS the sector is loaded here into another slot, so a slow read
+         * costs the frame no more than a miss; the worker's copy is evicted later.
+         */
+        if (slot_has(slot, key, SLOT_LOADING) && !slot_wait(slot, key)) {
+            continue;
+        }
+        #endif
+
+        if (!slot_has(slot, key, SLOT_READY) || !slot_claim(slot, SLOT_READY, SLOT_ACTIVE)) {
+            continue;
+        }
+
+        /* the claim only compares the state, the worker may have reused the slot in between */
+        if (atomic_load(&slot->key) == key) {
+            found = slot;
+        } else {
+            atomic_store(&slot->state, SLOT_READY);
+        }
+    }
+
+    if (found) {
+        stats.hits++;
+        return found->tiles;
+    }
+
+    /* not prefetched: evict something the worker isn't touching and load it here */
+    for (unsigned i = 0; i < num_slots && !found; i++) {
+        if (slot_claim(&slots[i], SLOT_FREE, SLOT_ACTIVE)) found = &slots[i];
+    }
+    for (unsigned i = 0; i < num_slots && !found; i++) {
+        if (slot_claim(&slots[i], SLOT_READY, SLOT_ACTIVE)) found = &slots[i];
+    }
+    if (!found) {
+        ABORT("no free sector buffer for h0x%uy%u", x, y);
+    }
+
+    atomic_store(&found->key, key);
+    if (!load(found->tiles, x, y)) {
+        atomic_store(&found->state, SLOT_FREE);
+        return NULL;
+    }
+    stats.misses++;
+
+    return found->tiles;
+}
+
+/* unpins a sector, it stays cached until the worker needs the slot */
+void prefetch_release(uint16_t x, uint16_t y) {
+    uint32_t key = SLOT_KEY(x, y);
+    for (unsigned i = 0; i < num_slots; i++) {
+        if (slot_has(&slots[i], key, SLOT_ACTIVE)) {
+            atomic_store(&slots[i].state, SLOT_READY);
+            return;
+        }
+    }
+}
+
+/* asks the worker to load every sector within radius of the given one */
+void prefetch_request(uint16_t x, uint16_t y, unsigned radius) {
+    #ifndef EMSCRIPTEN
+    pthread_mutex_lock(&lock);
+    center = SLOT_KEY(x, y);
+    reach = radius;
+    generation++;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    #endif
+}
+
+struct PrefetchStats prefetch_stats(void) {
+    return stats;
+}
@@ -0,0 +1,22 @@
+#ifndef PREFETCH_H_INCLUDED
+#define PREFETCH_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sector.h"
+
+/* fills all planes of the given sector, returns false if it doesn't exist */
+typedef bool (*SectorLoader)(struct SectorTiles *sector, uint16_t x, uint16_t y);
+
+struct PrefetchStats {
+    unsigned hits, misses;
+};
+
+void prefetch_init(SectorLoader loader, unsigned slot_count);
+void prefetch_shutdown(void);
+struct SectorTiles* prefetch_acquire(uint16_t x, uint16_t y);
+void prefetch_release(uint16_t x, uint16_t y);
+void prefetch_request(uint16_t x, uint16_t y, unsigned radius);
+struct PrefetchStats prefetch_stats(void);
+
+#endif // PREFETCH_H_INCLUDED
@@ -0,0 +1,103 @@
+/*
+ * frame phase timers. every finished phase is pushed into a ring of the most
+ * recent samples; the frame thread is the only writer and publishes a sample by
+ * advancing the head with a release store, so readers (the overlay, a dump)
+ * never block it. a reader on another thread may see the oldest samples of its
+ * copy replaced by newer ones, which only skews the window it summarizes.
+ */
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "profile.h"
+#include "trace.h"
+#include "util.h"
+
+const char *profile_phase_names[PHASE_COUNT] = {
+    "frame", "prepare", "ground", "walls", "wireframe", "models", "overlay"
+};
+
+static struct ProfileSample ring[PROFILE_RING_SIZE];
+static _Atomic uint32_t head;
+static double started[PHASE_COUNT];
+static uint32_t frame;
+
+void profile_begin(enum ProfilePhase phase) {
+    if (phase == PHASE_FRAME) frame++;
+    trace_begin(profile_phase_names[phase], NULL);
+    started[phase] = time_ms();
+}
+
+void profile_end(enum ProfilePhase phase) {
+    double now = time_ms();
+    uint32_t i = atomic_load_explicit(&head, memory_order_relaxed);
+
+    ring[i & (PROFILE_RING_SIZE - 1)] = (struct ProfileSample) { frame, phase, started[phase], now - started[phase] };
+    atomic_store_explicit(&head, i + 1, memory_order_release);
+    trace_end(profile_phase_names[phase]);
+}
+
+/* copies the durations of a phase out of the ring, returns how many */
+static unsigned profile_collect(enum ProfilePhase phase, double *out) {
+    uint32_t end = atomic_load_explicit(&head, memory_order_acquire);
+    uint32_t begin = end > PROFILE_RING_SIZE ? end - PROFILE_RING_SIZE : 0;
+    unsigned count = 0;
+
+    for (uint32_t i = begin; i < end; i++) {
+        struct ProfileSample *sample = &ring[i & (PROFILE_RING_SIZE - 1)];
+        if (sample->phase == phase) out[count++] = sample->duration;
+    }
+    return count;
+}
+
+static int profile_compare(const void *a, const void *b) {
+    double x = *(const double*) a, y = *(const double*) b;
+    return x < y ? -1 : x > y;
+}
+
+/* nearest rank percentiles over the samples in the ring */
+struct ProfileSummary profile_summary(enum ProfilePhase phase) {
+    static double durations[PROFILE_RING_SIZE];
+    struct ProfileSummary summary = { 0, 0, 0, 0, 0 };
+
+    summary.count = profile_collect(phase, durations);
+    if (!summary.count) return summary;
+
+    qsort(durations, summary.count, sizeof(double), profile_compare);
+    summary.p50 = durations[(summary.count * 50 + 99) / 100 - 1];
+    summary.p95 = durations[(summary.count * 95 + 99) / 100 - 1];
+    summary.p99 = durations[(summary.count * 99 + 99) / 100 - 1];
+    summary.max = durations[summary.count - 1];
+    return summary;
+}
+
+/* bins receives PROFILE_HIST_BINS counts */
+void profile_histogram(enum ProfilePhase phase, unsigned *bins) {
+    static double durations[PROFILE_RING_SIZE];
+    unsigned count = profile_collect(phase, durations);
+
+    for (unsigned i = 0; i < PROFILE_HIST_BINS; i++) bins[i] = 0;
+    for (unsigned i = 0; i < count; i++) {
+        unsigned bin = (unsigned) durations[i];
+        bins[bin < PROFILE_HIST_BINS ? bin : PROFILE_HIST_BINS - 1]++;
+    }
+}
+
+/* writes the samples in the ring as csv, oldest first */
+bool profile_dump(const char *fname) {
+    FILE *fp = fopen(fname, "w");
+    if (!fp) {
+        return false;
+    }
+
+    uint32_t end = atomic_load_explicit(&head, memory_order_acquire);
+    uint32_t begin = end > PROFILE_RING_SIZE ? end - PROFILE_RING_SIZE : 0;
+
+    fprintf(fp, "frame,phase,start_ms,duration_ms\n");
+    for (uint32_t i = begin; i < end; i++) {
+        struct ProfileSample *sample = &ring[i & (PROFILE_RING_SIZE - 1)];
+        fprintf(fp, "%u,%s,%.4f,%.4f\n", sample->frame, profile_phase_names[sample->phase],
+            sample->start, sample->duration);
+    }
+
+    return fclose(fp) == 0;
+}
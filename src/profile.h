@@ -0,0 +1,41 @@
+#ifndef PROFILE_H_INCLUDED
+#define PROFILE_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PROFILE_RING_SIZE   4096 /* samples kept, a power of two */
+#define PROFILE_HIST_BINS   32   /* 1 ms wide, the last one holds everything slower */
+
+/* timed phases of a frame, a frame spans all the others */
+enum ProfilePhase {
+    PHASE_FRAME,
+    PHASE_PREPARE,   /* rebuilding stale sector meshes */
+    PHASE_GROUND,    /* ground batches of every plane */
+    PHASE_WALLS,     /* wall batches of every plane */
+    PHASE_WIREFRAME,
+    PHASE_MODELS,
+    PHASE_OVERLAY,
+    PHASE_COUNT
+};
+
+struct ProfileSample {
+    uint32_t frame;
+    uint8_t phase;
+    double start, duration; /* ms */
+};
+
+struct ProfileSummary {
+    unsigned count;
+    double p50, p95, p99, max; /* ms */
+};
+
+extern const char *profile_phase_names[PHASE_COUNT];
+
+void profile_begin(enum ProfilePhase phase);
+void profile_end(enum ProfilePhase phase);
+struct ProfileSummary profile_summary(enum ProfilePhase phase);
+void profile_histogram(enum ProfilePhase phase, unsigned *bins);
+bool profile_dump(const char *fname);
+
+#endif // PROFILE_H_INCLUDED
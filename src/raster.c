@@ -0,0 +1,308 @@
+/*
+ * the software backend: rasterizes the frame into an rgb buffer on the CPU,
+ * following what the fixed-function pipeline does with the viewer's state
+ * (depth test GL_LEQUAL, alpha blending, textures modulated by the vertex
+ * color, no culling). texels are sampled nearest, lines are one pixel wide.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "matrix.h"
+#include "raster.h"
+#include "util.h"
+
+#define NEAR_EPSILON 1e-5F
+
+/* a vertex in clip space with its attributes */
+struct ClipVertex {
+    float x, y, z, w;
+    float u, v, r, g, b, a;
+};
+
+/* a vertex in window space, attributes divided by w for perspective correction */
+struct ScreenVertex {
+    float x, y, z, inv_w;
+    float attr[6];
+};
+
+static unsigned width, height;
+static uint8_t *color;
+static float *depth;
+static float mvp[16];
+static const struct TextureAtlas *texture;
+
+void raster_init(unsigned w, unsigned h) {
+    width = w;
+    height = h;
+    color = xmalloc((size_t) w * h * 3);
+    depth = xmalloc((size_t) w * h * sizeof(float));
+    mat4_identity(mvp);
+    raster_clear(0, 0, 0);
+}
+
+void raster_cleanup(void) {
+    free(color);
+    free(depth);
+    color = NULL;
+    depth = NULL;
+}
+
+void raster_clear(uint8_t r, uint8_t g, uint8_t b) {
+    for (size_t i = 0; i < (size_t) width * height; i++) {
+        color[i * 3 + 0] = r;
+        color[i * 3 + 1] = g;
+        color[i * 3 + 2] = b;
+        depth[i] = 1;
+    }
+}
+
+const uint8_t* raster_pixels(void) {
+    return color;
+}
+
+bool raster_write_ppm(const char *fname) {
+    FILE *fp = fopen(fname, "wb");
+    if (!fp) {
+        return false;
+    }
+
+    fprintf(fp, "P6\n%u %u\n255\n", width, height);
+    fwrite(color, 3, (size_t) width * height, fp);
+
+    return fclose(fp) == 0;
+}
+
+static struct ClipVertex raster_project(const struct RenderVertex *vertex) {
+    struct ClipVertex clip;
+    float in[4] = { vertex->x, vertex->y, vertex->z, 1 };
+    float out[4];
+
+    for (unsigned row = 0; row < 4; row++) {
+        out[row] = mvp[row] * in[0] + mvp[4 + row] * in[1] + mvp[8 + row] * in[2] + mvp[12 + row] * in[3];
+    }
+
+    clip.x = out[0]; clip.y = out[1]; clip.z = out[2]; clip.w = out[3];
+    clip.u = vertex->u;
+    clip.v = vertex->v;
+    clip.r = vertex->r;
+    clip.g = vertex->g;
+    clip.b = vertex->b;
+    clip.a = vertex->a;
+    return clip;
+}
+
+static float raster_near_distance(const struct ClipVertex *vertex) {
+    return vertex->z + vertex->w;
+}
+
+static struct ClipVertex raster_lerp(const struct ClipVertex *a, const struct ClipVertex *b, float t) {
+    const float *pa = &a->x, *pb = &b->x;
+    struct ClipVertex out;
+    float *po = &out.x;
+
+    for (unsigned i = 0; i < sizeof(struct ClipVertex) / sizeof(float); i++) {
+        po[i] = pa[i] + (pb[i] - pa[i]) * t;
+    }
+    return out;
+}
+
+/* clips a polygon against the near plane, returns the number of vertices left in out */
+static unsigned raster_clip_near(const struct ClipVertex *in, unsigned count, struct ClipVertex *out) {
+    unsigned n = 0;
+
+    for (unsigned i = 0; i < count; i++) {
+        const struct ClipVertex *a = &in[i], *b = &in[(i + 1) % count];
+        float da = raster_near_distance(a), db = raster_near_distance(b);
+
+        if (da >= 0) out[n++] = *a;
+        if ((da >= 0) != (db >= 0)) out[n++] = raster_lerp(a, b, da / (da - db));
+    }
+    return n;
+}
+
+static struct ScreenVertex raster_viewport(const struct ClipVertex *clip) {
+    struct ScreenVertex screen;
+    float w = clip->w > NEAR_EPSILON ? clip->w : NEAR_EPSILON;
+
+    screen.inv_w = 1 / w;
+    screen.x = (clip->x * screen.inv_w + 1) * 0.5F * width;
+    screen.y = (1 - clip->y * screen.inv_w) * 0.5F * height;
+    screen.z = clip->z * screen.inv_w * 0.5F + 0.5F;
+
+    const float *attr = &clip->u;
+    for (unsigned i = 0; i < 6; i++) {
+        screen.attr[i] = attr[i] * screen.inv_w;
+    }
+    return screen;
+}
+
+static void raster_sample(float u, float v, float *rgba) {
+    int x = (int) floorf(u * texture->width);
+    int y = (int) floorf(v * texture->height);
+
+    /* GL_CLAMP */
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x >= texture->width)  x = texture->width - 1;
+    if (y >= texture->height) y = texture->height - 1;
+
+    const uint8_t *texel = texture->pixels + ((size_t) y * texture->width + x) * 4;
+    for (unsigned i = 0; i < 4; i++) {
+        rgba[i] = texel[i] / 255.0F;
+    }
+}
+
+/* depth tested, alpha blended write of one fragment, rgba in 0..255 */
+static void raster_fragment(unsigned x, unsigned y, float z, const float *rgba) {
+    size_t i = (size_t) y * width + x;
+
+    if (z < 0 || z > 1 || z > depth[i]) return;
+    depth[i] = z;
+
+    float alpha = rgba[3] / 255;
+    uint8_t *dst = color + i * 3;
+    for (unsigned c = 0; c < 3; c++) {
+        float value = rgba[c] * alpha + dst[c] * (1 - alpha);
+        dst[c] = value < 0 ? 0 : value > 255 ? 255 : (uint8_t) (value + 0.5F);
+    }
+}
+
+static float raster_edge(const struct ScreenVertex *a, const struct ScreenVertex *b, float x, float y) {
+    return (b->x - a->x) * (y - a->y) - (b->y - a->y) * (x - a->x);
+}
+
+static void raster_triangle(const struct ScreenVertex *v0, const struct ScreenVertex *v1, const struct ScreenVertex *v2) {
+    float area = raster_edge(v0, v1, v2->x, v2->y);
+    if (area == 0 || !isfinite(area)) return;
+
+    float min_x = fminf(v0->x, fminf(v1->x, v2->x)), max_x = fmaxf(v0->x, fmaxf(v1->x, v2->x));
+    float min_y = fminf(v0->y, fminf(v1->y, v2->y)), max_y = fmaxf(v0->y, fmaxf(v1->y, v2->y));
+    int x0 = min_x < 0 ? 0 : (int) min_x, x1 = max_x >= width  ? (int) width  - 1 : (int) max_x;
+    int y0 = min_y < 0 ? 0 : (int) min_y, y1 = max_y >= height ? (int) height - 1 : (int) max_y;
+
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            float px = x + 0.5F, py = y + 0.5F;
+            float l0 = raster_edge(v1, v2, px, py) / area;
+            float l1 = raster_edge(v2, v0, px, py) / area;
+            float l2 = raster_edge(v0, v1, px, py) / area;
+
+            if (l0 < 0 || l1 < 0 || l2 < 0) continue;
+
+            float z = l0 * v0->z + l1 * v1->z + l2 * v2->z;
+            float w = 1 / (l0 * v0->inv_w + l1 * v1->inv_w + l2 * v2->inv_w);
+            float attr[6];
+            for (unsigned i = 0; i < 6; i++) {
+                attr[i] = (l0 * v0->attr[i] + l1 * v1->attr[i] + l2 * v2->attr[i]) * w;
+            }
+
+            /* GL_MODULATE */
+            float rgba[4] = { attr[2], attr[3], attr[4], attr[5] };
+            if (texture && texture->pixels) {
+                float texel[4];
+                raster_sample(attr[0], attr[1], texel);
+                for (unsigned c = 0; c < 4; c++) rgba[c] *= texel[c];
+            }
+
+            raster_fragment(x, y, z, rgba);
+        }
+    }
+}
+
+/* the atlases are sampled straight from their pixels, which are kept. wait for them to be complete before drawing */
+static void raster_upload(struct TextureAtlas *atlas) {
+    atlas->texture = 0;
+}
+
+static void raster_begin(void) {
+    texture = NULL;
+}
+
+static void raster_end(void) {
+}
+
+static void raster_transform(const float *projection, const float *modelview) {
+    mat4_multiply(mvp, projection, modelview);
+}
+
+static void raster_texture(const struct TextureAtlas *atlas) {
+    texture = atlas;
+}
+
+static void raster_triangles(const struct RenderVertex *vertices, uint32_t count) {
+    for (uint32_t i = 0; i + 2 < count; i += 3) {
+        struct ClipVertex in[3], clipped[4];
+        struct ScreenVertex screen[4];
+
+        for (unsigned k = 0; k < 3; k++) {
+            in[k] = raster_project(&vertices[i + k]);
+        }
+
+        unsigned n = raster_clip_near(in, 3, clipped);
+        for (unsigned k = 0; k < n; k++) {
+            screen[k] = raster_viewport(&clipped[k]);
+        }
+        for (unsigned k = 2; k < n; k++) {
+            raster_triangle(&screen[0], &screen[k - 1], &screen[k]);
+        }
+    }
+}
+
+static void raster_lines(const float (*vertices)[3], const uint16_t *indices, uint32_t count, const uint8_t *rgba) {
+    float fragment[4] = { rgba[0], rgba[1], rgba[2], rgba[3] };
+
+    for (uint32_t i = 0; i + 1 < count; i += 2) {
+        struct ClipVertex ends[2];
+
+        for (unsigned k = 0; k < 2; k++) {
+            const float *p = vertices[indices[i + k]];
+            ends[k] = raster_project(&(struct RenderVertex) { p[0], p[1], p[2], 0, 0, 0, 0, 0, 0 });
+        }
+
+        float d0 = raster_near_distance(&ends[0]), d1 = raster_near_distance(&ends[1]);
+        if (d0 < 0 && d1 < 0) continue;
+        if (d0 < 0) ends[0] = raster_lerp(&ends[0], &ends[1], d0 / (d0 - d1));
+        if (d1 < 0) ends[1] = raster_lerp(&ends[1], &ends[0], d1 / (d1 - d0));
+
+        struct ScreenVertex a = raster_viewport(&ends[0]), b = raster_viewport(&ends[1]);
+        float dx = b.x - a.x, dy = b.y - a.y, dz = b.z - a.z;
+
+        /* clip the segment to the window so only visible pixels are stepped through */
+        float t0 = 0, t1 = 1;
+        float p[4] = { -dx, dx, -dy, dy };
+        float q[4] = { a.x, width - a.x, a.y, height - a.y };
+        for (unsigned k = 0; k < 4 && t0 <= t1; k++) {
+            if (p[k] == 0) {
+                if (q[k] < 0) t0 = 2;
+            } else if (p[k] < 0) {
+                t0 = fmaxf(t0, q[k] / p[k]);
+            } else {
+                t1 = fminf(t1, q[k] / p[k]);
+            }
+        }
+        if (t0 > t1) continue;
+
+        float steps = ceilf(fmaxf(fabsf(dx), fabsf(dy)) * (t1 - t0));
+        if (!isfinite(steps)) continue;
+        if (steps < 1) steps = 1;
+
+        for (float s = 0; s <= steps; s++) {
+            float t = t0 + (t1 - t0) * s / steps;
+            float x = a.x + dx * t, y = a.y + dy * t;
+            if (x < 0 || y < 0 || x >= width || y >= height) continue;
+            raster_fragment((unsigned) x, (unsigned) y, a.z + dz * t, fragment);
+        }
+    }
+}
+
+const struct Renderer render_soft = {
+    "Software",
+    raster_upload,
+    raster_begin,
+    raster_end,
+    raster_transform,
+    raster_texture,
+    raster_triangles,
+    raster_lines
+};
@@ -0,0 +1,16 @@
+#ifndef RASTER_H_INCLUDED
+#define RASTER_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "render.h"
+
+void raster_init(unsigned width, unsigned height);
+void raster_cleanup(void);
+void raster_clear(uint8_t r, uint8_t g, uint8_t b);
+const uint8_t* raster_pixels(void); /* rgb, top row first */
+bool raster_write_ppm(const char *fname);
+
+extern const struct Renderer render_soft;
+
+#endif // RASTER_H_INCLUDED
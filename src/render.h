@@ -0,0 +1,32 @@
+#ifndef RENDER_H_INCLUDED
+#define RENDER_H_INCLUDED
+
+#include <stdint.h>
+#include "atlas.h"
+
+/* the vertex layout of terrain and model meshes */
+struct RenderVertex {
+    float x, y, z;
+    float u, v; /* atlas coordinates */
+    uint8_t r, g, b, a;
+};
+
+/*
+ * the primitives a frame of the scene is made of. the world is drawn through one
+ * of these, either by fixed-function GL (render_gl.c) or by the software
+ * rasterizer (raster.c). matrices are column major, as in GL.
+ */
+struct Renderer {
+    const char *name;
+    void (*upload)(struct TextureAtlas *atlas); /* called once an atlas is laid out and again once it is complete */
+    void (*begin)(void);
+    void (*end)(void);
+    void (*transform)(const float *projection, const float *modelview);
+    void (*texture)(const struct TextureAtlas *atlas); /* NULL draws untextured */
+    void (*triangles)(const struct RenderVertex *vertices, uint32_t count);
+    void (*lines)(const float (*vertices)[3], const uint16_t *indices, uint32_t count, const uint8_t *rgba);
+};
+
+extern const struct Renderer render_gl;
+
+#endif // RENDER_H_INCLUDED
@@ -0,0 +1,103 @@
+/*
+ * the fixed-function GL 1.1 backend. meshes are drawn from client-side vertex
+ * arrays, the atlases live in GL textures.
+ */
+#include <stdlib.h>
+
+#ifdef EMSCRIPTEN
+    #include <GLFW/glfw3.h>
+#elif __APPLE__
+    #include <OpenGL/gl.h>
+#else
+    #include <GL/gl.h>
+#endif
+
+#include "render.h"
+
+/* the placeholder atlas is replaced in place, its pixels are only freed once the complete one is up */
+static void gl_upload(struct TextureAtlas *atlas) {
+    if (atlas->texture) {
+        glBindTexture(GL_TEXTURE_2D, atlas->texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, atlas->width, atlas->height, GL_RGBA, GL_UNSIGNED_BYTE, atlas->pixels);
+    } else {
+        glGenTextures(1, &atlas->texture);
+        glBindTexture(GL_TEXTURE_2D, atlas->texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+        glTexImage2D(GL_TEXTURE_2D, 0, atlas->transparent ? GL_RGBA : GL_RGB, atlas->width, atlas->height,
+            0, GL_RGBA, GL_UNSIGNED_BYTE, atlas->pixels);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (atlas->complete) {
+        free(atlas->pixels);
+        atlas->pixels = NULL;
+    }
+}
+
+static void gl_begin(void) {
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glColor3f(1, 1, 1);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+}
+
+/* leaves the client state as the immediate mode overlay expects it */
+static void gl_end(void) {
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+static void gl_transform(const float *projection, const float *modelview) {
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(projection);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadMatrixf(modelview);
+}
+
+static void gl_texture(const struct TextureAtlas *atlas) {
+    if (atlas) {
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, atlas->texture);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glDisable(GL_TEXTURE_2D);
+    }
+}
+
+static void gl_triangles(const struct RenderVertex *vertices, uint32_t count) {
+    const GLsizei stride = sizeof(struct RenderVertex);
+
+    glVertexPointer(3, GL_FLOAT, stride, &vertices->x);
+    glTexCoordPointer(2, GL_FLOAT, stride, &vertices->u);
+    glColorPointer(4, GL_UNSIGNED_BYTE, stride, &vertices->r);
+    glDrawArrays(GL_TRIANGLES, 0, count);
+}
+
+static void gl_lines(const float (*vertices)[3], const uint16_t *indices, uint32_t count, const uint8_t *rgba) {
+    glDisableClientState(GL_COLOR_ARRAY);
+    glColor4ub(rgba[0], rgba[1], rgba[2], rgba[3]);
+    glLineWidth(1);
+
+    glVertexPointer(3, GL_FLOAT, 0, vertices);
+    glDrawElements(GL_LINES, count, GL_UNSIGNED_SHORT, indices);
+
+    glEnableClientState(GL_COLOR_ARRAY);
+}
+
+const struct Renderer render_gl = {
+    "OpenGL 1.1",
+    gl_upload,
+    gl_begin,
+    gl_end,
+    gl_transform,
+    gl_texture,
+    gl_triangles,
+    gl_lines
+};
@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sector.h"
+#include "util.h"
+
+bool sector_archive_open(struct SectorArchive *archive, const char *fname) {
+    archive->data = map_file(fname, &archive->length);
+
+    if (!archive->data) {
+        return false;
+    }
+
+    const uint8_t *header = archive->data;
+
+    if (archive->length < ARCHIVE_HEADER_SIZE + ARCHIVE_INDEX_SIZE
+            || memcmp(header, ARCHIVE_MAGIC, 4) != 0) {
+        ABORT("not a sector archive: %s", fname);
+    }
+
+    if (get_le16(header + 4) != ARCHIVE_VERSION) {
+        ABORT("unsupported sector archive version %u: %s", get_le16(header + 4), fname);
+    }
+
+    if (get_le16(header + 6)  != SECTOR_PLANES
+            || get_le16(header + 8)  != SECTOR_MIN_X
+            || get_le16(header + 10) != SECTOR_MIN_Y
+            || get_le16(header + 12) != SECTOR_COLS
+            || get_le16(header + 14) != SECTOR_ROWS) {
+        ABORT("sector archive has unexpected bounds: %s", fname);
+    }
+
+    /* validate every entry once up front so lookups can trust the index */
+    const uint8_t *entry = header + ARCHIVE_HEADER_SIZE;
+    for (unsigned i = 0; i < ARCHIVE_INDEX_SIZE / ARCHIVE_ENTRY_SIZE; i++, entry += ARCHIVE_ENTRY_SIZE) {
+        uint32_t offset = get_le32(entry);
+        uint16_t length = get_le16(entry + 4);
+        uint8_t codec   = entry[6];
+        bool valid_codec = (codec == CODEC_RAW && length == SECTOR_SIZE)
+                        || (codec == CODEC_RLE && length <= SECTOR_SIZE);
+        bool in_file = offset >= ARCHIVE_HEADER_SIZE + ARCHIVE_INDEX_SIZE
+                    && length <= archive->length && offset <= archive->length - length;
+        if (offset && (!valid_codec || !in_file)) {
+            ABORT("corrupt sector archive entry %u: %s", i, fname);
+        }
+    }
+
+    return true;
+}
+
+void sector_archive_close(struct SectorArchive *archive) {
+    unmap_file(archive->data, archive->length);
+    archive->data = NULL;
+    archive->length = 0;
+}
+
+/*
+ * returns the raw (SECTOR_SIZE byte) payload of a sector, NULL if absent. uncompressed
+ * sectors point straight into the mapped archive, compressed ones are decoded into scratch.
+ */
+const uint8_t* sector_archive_read(const struct SectorArchive *archive, uint8_t plane, uint16_t x, uint16_t y, uint8_t *scratch) {
+    if (!archive->data || !sector_in_bounds(plane, x, y)) {
+        return NULL;
+    }
+
+    const uint8_t *entry = archive->data + ARCHIVE_HEADER_SIZE + sector_index(plane, x, y) * ARCHIVE_ENTRY_SIZE;
+    uint32_t offset = get_le32(entry);
+    uint16_t length = get_le16(entry + 4);
+
+    if (!offset) {
+        return NULL;
+    }
+
+    if (entry[6] == CODEC_RAW) {
+        return archive->data + offset;
+    }
+
+    if (!sector_decode_rle(archive->data + offset, length, scratch)) {
+        ABORT("corrupt sector payload: h%ux%uy%u", plane, x, y);
+    }
+    return scratch;
+}
+
+/* out must hold at least SECTOR_SIZE + SECTOR_SIZE / 128 + 1 bytes, returns the encoded length */
+size_t sector_encode_rle(const uint8_t *raw, uint8_t *out) {
+    uint8_t stream[SECTOR_SIZE];
+    size_t n = 0;
+
+    /* transpose the tile records so that equal fields end up next to each other */
+    for (unsigned field = 0; field < TILE_RECORD_SIZE; field++) {
+        for (unsigned i = field; i < SECTOR_SIZE; i += TILE_RECORD_SIZE) {
+            stream[n++] = raw[i];
+        }
+    }
+
+    size_t len = 0;
+    size_t i = 0;
+    while (i < SECTOR_SIZE) {
+        size_t run = 1;
+        while (i + run < SECTOR_SIZE && run < 128 && stream[i + run] == stream[i]) {
+            run++;
+        }
+
+        if (run >= 3) {
+            out[len++] = 257 - run;
+            out[len++] = stream[i];
+            i += run;
+            continue;
+        }
+
+        /* gather literals until the next run worth encoding */
+        size_t start = i;
+        while (i < SECTOR_SIZE && i - start < 128) {
+            if (i + 2 < SECTOR_SIZE && stream[i] == stream[i + 1] && stream[i] == stream[i + 2]) {
+                break;
+            }
+            i++;
+        }
+        out[len++] = i - start - 1;
+        memcpy(out + len, stream + start, i - start);
+        len += i - start;
+    }
+
+    return len;
+}
+
+bool sector_decode_rle(const uint8_t *src, size_t length, uint8_t *raw) {
+    const uint8_t *end = src + length;
+
+    /* n walks the transposed stream, dst is where that byte lives in the tile records */
+    unsigned n = 0;
+    unsigned dst = 0;
+
+    #define EMIT(byte) do { \
+        raw[dst] = (byte); \
+        dst += TILE_RECORD_SIZE; \
+        if (dst >= SECTOR_SIZE) dst -= SECTOR_SIZE - 1; /* next field */ \
+        n++; \
+    } while(0)
+
+    while (src < end) {
+        uint8_t c = *src++;
+
+        if (c < 128) {
+            unsigned count = c + 1;
+            if (count > (size_t) (end - src) || n + count > SECTOR_SIZE) {
+                return false;
+            }
+            while (count--) EMIT(*src++);
+        } else if (c > 128) {
+            unsigned count = 257 - c;
+            if (src == end || n + count > SECTOR_SIZE) {
+                return false;
+            }
+            uint8_t byte = *src++;
+            while (count--) EMIT(byte);
+        }
+    }
+
+    #undef EMIT
+
+    return n == SECTOR_SIZE;
+}
+
+bool sector_in_bounds(uint8_t plane, uint16_t x, uint16_t y) {
+    return plane < SECTOR_PLANES
+        && x >= SECTOR_MIN_X && x < SECTOR_MIN_X + SECTOR_COLS
+        && y >= SECTOR_MIN_Y && y < SECTOR_MIN_Y + SECTOR_ROWS;
+}
+
+unsigned sector_index(uint8_t plane, uint16_t x, uint16_t y) {
+    return (plane * SECTOR_COLS + (x - SECTOR_MIN_X)) * SECTOR_ROWS + (y - SECTOR_MIN_Y);
+}
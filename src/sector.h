@@ -0,0 +1,80 @@
+#ifndef SECTOR_H_INCLUDED
+#define SECTOR_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SECTOR_SIZE     23040 /* file size in bytes */
+#define TILE_RECORD_SIZE 10   /* bytes per tile in a sector file */
+
+/* bounds of the sector grid shipped in data/sectors */
+#define SECTOR_PLANES   4
+#define SECTOR_MIN_X    48
+#define SECTOR_MIN_Y    37
+#define SECTOR_COLS     21
+#define SECTOR_ROWS     21
+
+/*
+ * packed world archive (all fields little endian):
+ *   header  magic "RSCW", u16 version, u16 planes, u16 min_x, u16 min_y, u16 cols, u16 rows
+ *   index   planes * cols * rows entries of { u32 offset, u16 length, u8 codec, u8 reserved },
+ *           plane-major then x then y (an offset of 0 marks a sector that isn't present)
+ *   data    contiguous sector payloads, each stored with its own codec
+ */
+#define ARCHIVE_MAGIC       "RSCW"
+#define ARCHIVE_VERSION     2
+#define ARCHIVE_HEADER_SIZE 16
+#define ARCHIVE_ENTRY_SIZE  8
+#define ARCHIVE_INDEX_SIZE  (SECTOR_PLANES * SECTOR_COLS * SECTOR_ROWS * ARCHIVE_ENTRY_SIZE)
+
+/*
+ * sector payload codecs. CODEC_RLE transposes the 10-byte tile records into
+ * one stream per field (all heights, then all colors, ...) and run-length
+ * encodes the result packbits style: a control byte c of 0..127 is followed
+ * by c+1 literal bytes, 129..255 repeats the next byte 257-c times.
+ */
+enum SectorCodec {
+    CODEC_RAW,
+    CODEC_RLE
+};
+
+/* how a textured tile is cut against its untextured neighbours, worked out when the tiles are decoded */
+enum CropStyle {
+    CROP_NONE,
+    CROP_TOP_RIGHT,
+    CROP_TOP_LEFT,
+    CROP_BOTTOM_RIGHT,
+    CROP_BOTTOM_LEFT
+};
+
+/*
+ * all planes of a sector as one array per tile field, indexed [plane][x][z] like
+ * the records of the sector files. the fields every tile reads (height, texture,
+ * color) come first, the roofs and walls only matter to some of them.
+ */
+struct SectorTiles {
+    uint8_t height[SECTOR_PLANES][48][48];
+    uint8_t texture[SECTOR_PLANES][48][48];
+    uint8_t color[SECTOR_PLANES][48][48];
+    uint8_t crop[SECTOR_PLANES][48][48]; /* enum CropStyle, from the textures rather than the records */
+
+    uint8_t roof[SECTOR_PLANES][48][48];
+    uint8_t wall_east[SECTOR_PLANES][48][48];
+    uint8_t wall_north[SECTOR_PLANES][48][48];
+    uint16_t wall_diag[SECTOR_PLANES][48][48]; /* low 16 bits of the 32 bit value in the record */
+};
+
+struct SectorArchive {
+    uint8_t *data;
+    size_t length;
+};
+
+bool sector_archive_open(struct SectorArchive *archive, const char *fname);
+void sector_archive_close(struct SectorArchive *archive);
+const uint8_t* sector_archive_read(const struct SectorArchive *archive, uint8_t plane, uint16_t x, uint16_t y, uint8_t *scratch);
+size_t sector_encode_rle(const uint8_t *raw, uint8_t *out);
+bool sector_decode_rle(const uint8_t *src, size_t length, uint8_t *raw);
+bool sector_in_bounds(uint8_t plane, uint16_t x, uint16_t y);
+unsigned sector_index(uint8_t plane, uint16_t x, uint16_t y);
+#endif // SECTOR_H_INCLUDED
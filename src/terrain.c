@@ -0,0 +1,717 @@
+/*
+ * builds the retained terrain, wall and wireframe geometry of a sector. this
+ * follows the old immediate mode tile_draw() path tile for tile, but emits
+ * into vertex arrays once instead of issuing GL calls every frame.
+ * triangles are grouped by texture atlas, then by chunk of 8x8 tiles, so a sector
+ * needs one draw per atlas unless some of its chunks are culled.
+ */
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include "terrain.h"
+#include "util.h"
+
+struct Quad {
+    uint8_t a, b, c, d;
+};
+
+/*
+ * tile vertex types [1-4: terrain vertices] [5: terrain connector] [6-9: wall vertices] [10-12: wall connectors]
+ * as the corner the vertex sits on, the tile its height is taken from and whether it tops a wall
+ */
+static const struct {
+    uint8_t x, z, hx, hz, wall;
+} vertex_types[13] = {
+    { 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0 }, { 0, 1, 0, 1, 0 }, { 1, 1, 1, 1, 0 }, { 1, 0, 1, 0, 0 },
+    { 0, 0, 0, 0, 1 }, { 0, 1, 0, 1, 1 }, { 1, 1, 0, 1, 1 }, { 1, 0, 1, 0, 1 },
+    { 1, 0, 1, 0, 0 }, { 0, 1, 1, 1, 0 }, { 0, 1, 0, 1, 1 }, { 1, 0, 1, 0, 1 }
+};
+
+static uint8_t ground_colors[256][3];
+static const struct TextureAtlas *ground_atlas, *wall_atlas;
+
+void terrain_init(const struct TextureAtlas *ground, const struct TextureAtlas *wall) {
+    ground_atlas = ground;
+    wall_atlas = wall;
+
+    unsigned i;
+    for(i = 0; i < 64; i++) {
+        ground_colors[i][0] = 255 - i * 4;
+        ground_colors[i][1] = 255 - i * 1.75;
+        ground_colors[i][2] = 255 - i * 4;
+    }
+    for(i = 0; i < 64; i++) {
+        ground_colors[i+64][0] = i * 3;
+        ground_colors[i+64][1] = 144;
+        ground_colors[i+64][2] = 0;
+    }
+    for(i = 0; i < 64; i++) {
+        ground_colors[i+128][0] = 192 - i * 1.5;
+        ground_colors[i+128][1] = 144 - i * 1.5;
+        ground_colors[i+128][2] = 0;
+    }
+    for(i = 0; i < 64; i++) {
+        ground_colors[i+192][0] = 96 - i * 1.5;
+        ground_colors[i+192][1] = 48 + i * 1.5;
+        ground_colors[i+192][2] = 0;
+    }
+}
+
+/* grows a mesh array so that it can hold extra more elements */
+#define RESERVE(array, count, max, extra) do { \
+    if ((count) + (extra) > (max)) { \
+        (max) = ((count) + (extra)) * 2; \
+        (array) = realloc((array), (max) * sizeof(*(array))); \
+        if (!(array)) ABORT("realloc: failed to grow %s", #array); \
+    } \
+} while(0)
+
+/*
+ * tile height relative to the sector being built; coordinates of 48 step across the
+ * seam into the neighbouring sector, or stay on the edge tile past the window.
+ */
+static uint8_t terrain_tile_height(struct TerrainSource *source, unsigned x, unsigned z, unsigned plane) {
+    const struct SectorTiles *tiles = source->tiles;
+    bool east = false;
+
+    if (x >= 48) {
+        if (source->east) {
+            tiles = source->east;
+            east = true;
+            x -= 48;
+        } else {
+            x = 47;
+        }
+    }
+    if (z >= 48) {
+        const struct SectorTiles *south = east ? source->south_east : source->south;
+        if (south) {
+            tiles = south;
+            z -= 48;
+        } else {
+            z = 47;
+        }
+    }
+
+    return tiles->height[plane][x][z];
+}
+
+static float terrain_plane_height(unsigned plane) {
+    switch(plane) {
+        /* first floor */
+        case 1:  return -1.56;
+        /* second floor */
+        case 2:  return -3.12;
+        /* underground */
+        case 3:  return  12.0;
+        /* ground floor */
+        default: return   0.0;
+    }
+}
+
+/* the raw corner heights of a plane, with the seams to the neighbouring sectors resolved */
+static void terrain_corners(struct TerrainSource *source, unsigned plane, uint8_t corners[49][49]) {
+    for (unsigned x = 0; x < 48; x++) {
+        memcpy(corners[x], source->tiles->height[plane][x], 48);
+        corners[x][48] = terrain_tile_height(source, x, 48, plane);
+    }
+    for (unsigned z = 0; z < 49; z++) {
+        corners[48][z] = terrain_tile_height(source, 48, z, plane);
+    }
+}
+
+/* scales a whole corner grid to heights in one flat loop, which the compiler vectorizes */
+static void terrain_height_grid(float *restrict heights, const uint8_t *restrict corners, float base,
+                                unsigned raise, float tile_scale) {
+    for (unsigned i = 0; i < 49 * 49; i++) {
+        heights[i] = base - (corners[i] + raise) / 255. * tile_scale;
+    }
+}
+
+static struct RenderVertex terrain_vertex(struct TerrainMesh *mesh, uint8_t type, unsigned x, unsigned z, unsigned plane) {
+    struct RenderVertex vertex;
+    vertex.x = (int) (x + vertex_types[type].x) - 24;
+    vertex.z = (int) (z + vertex_types[type].z) - 24;
+    vertex.y = mesh->heights[plane][vertex_types[type].wall][x + vertex_types[type].hx][z + vertex_types[type].hz];
+    vertex.u = vertex.v = 0;
+    vertex.r = vertex.g = vertex.b = vertex.a = 255;
+    return vertex;
+}
+
+/* starts a new batch unless the previous one can be extended, lines batch up their indices */
+static void terrain_batch_add(struct TerrainMesh *mesh, uint8_t kind, uint8_t chunk, uint8_t lod, uint32_t count) {
+    struct TerrainBatch *last = mesh->num_batches ? &mesh->batches[mesh->num_batches - 1] : NULL;
+    uint32_t first = kind == BATCH_LINES ? mesh->num_line_indices : mesh->num_vertices;
+
+    if (last && last->kind == kind && last->chunk == chunk && last->lod == lod && last->first + last->count == first) {
+        last->count += count;
+        return;
+    }
+
+    RESERVE(mesh->batches, mesh->num_batches, mesh->max_batches, 1);
+    mesh->batches[mesh->num_batches++] = (struct TerrainBatch) { kind, chunk, lod, first, count };
+}
+
+/* the full detail geometry of a tile, only the ground floor and underground terrain has coarser levels */
+static void terrain_batch(struct TerrainMesh *mesh, uint8_t kind, unsigned x, unsigned z, unsigned plane, uint32_t count) {
+    uint8_t chunk = TERRAIN_CHUNK_INDEX(x, z);
+    bool detailed = kind == BATCH_WALL || mesh->detailed[plane] >> chunk & 1;
+    terrain_batch_add(mesh, kind, chunk, detailed ? TERRAIN_LOD_ALL : 0, count);
+}
+
+/* where a triangle batch goes in the counting sort, TERRAIN_LOD_ALL before the levels */
+static uint32_t terrain_batch_key(const struct TerrainBatch *batch) {
+    uint32_t rank = batch->lod == TERRAIN_LOD_ALL ? 0 : batch->lod + 1u;
+    return (batch->kind * (TERRAIN_LODS + 1u) + rank) * TERRAIN_CHUNKS * TERRAIN_CHUNKS + batch->chunk;
+}
+
+/*
+ * regroups the triangles so that every chunk of an atlas is drawn by a single batch per
+ * level: a counting sort on kind, level and chunk that moves the vertices into place.
+ * the lines keep their order and go last, as their indices aren't moved.
+ */
+static void terrain_sort_batches(struct TerrainMesh *mesh) {
+    enum { KEYS = BATCH_LINES * (TERRAIN_LODS + 1) * TERRAIN_CHUNKS * TERRAIN_CHUNKS };
+    uint32_t offsets[KEYS] = { 0 }, ends[KEYS];
+    uint32_t lines = 0;
+
+    for (uint32_t i = 0; i < mesh->num_batches; i++) {
+        struct TerrainBatch *batch = &mesh->batches[i];
+        if (batch->kind != BATCH_LINES) offsets[terrain_batch_key(batch)] += batch->count;
+    }
+    for (uint32_t key = 0, first = 0; key < KEYS; key++) {
+        uint32_t count = offsets[key];
+        offsets[key] = first;
+        first += count;
+    }
+    memcpy(ends, offsets, sizeof(ends));
+
+    /* gather the triangles in batch order into the staging array, which then becomes the vertex array */
+    RESERVE(mesh->scratch, 0, mesh->max_scratch, mesh->num_vertices);
+
+    for (uint32_t i = 0; i < mesh->num_batches; i++) {
+        struct TerrainBatch batch = mesh->batches[i];
+
+        if (batch.kind == BATCH_LINES) {
+            struct TerrainBatch *prev = lines ? &mesh->batches[lines - 1] : NULL;
+            if (prev && prev->chunk == batch.chunk && prev->lod == batch.lod && prev->first + prev->count == batch.first) {
+                prev->count += batch.count;
+            } else {
+                mesh->batches[lines++] = batch;
+            }
+            continue;
+        }
+
+        uint32_t *end = &ends[terrain_batch_key(&batch)];
+        memcpy(mesh->scratch + *end, mesh->vertices + batch.first, batch.count * sizeof(struct RenderVertex));
+        *end += batch.count;
+    }
+
+    uint32_t triangles = 0;
+    for (uint32_t key = 0; key < KEYS; key++) {
+        if (ends[key] != offsets[key]) triangles++;
+    }
+
+    /* the line batches were packed to the front, the triangle batches go before them */
+    RESERVE(mesh->batches, triangles, mesh->max_batches, lines);
+    memmove(mesh->batches + triangles, mesh->batches, lines * sizeof(struct TerrainBatch));
+    mesh->num_batches = 0;
+    for (uint32_t key = 0; key < KEYS; key++) {
+        if (ends[key] == offsets[key]) continue;
+        uint32_t group = key / (TERRAIN_CHUNKS * TERRAIN_CHUNKS), rank = group % (TERRAIN_LODS + 1);
+        mesh->batches[mesh->num_batches++] = (struct TerrainBatch) {
+            group / (TERRAIN_LODS + 1), key % (TERRAIN_CHUNKS * TERRAIN_CHUNKS), rank ? rank - 1 : TERRAIN_LOD_ALL,
+            offsets[key], ends[key] - offsets[key]
+        };
+    }
+    mesh->num_batches += lines;
+
+    struct RenderVertex *vertices = mesh->vertices;
+    uint32_t max_vertices = mesh->max_vertices;
+    mesh->vertices = mesh->scratch;
+    mesh->max_vertices = mesh->max_scratch;
+    mesh->scratch = vertices;
+    mesh->max_scratch = max_vertices;
+}
+
+void terrain_chunk_extend(struct TerrainChunk *chunk, const float *min, const float *max) {
+    for (unsigned i = 0; i < 3; i++) {
+        if (min[i] < chunk->min[i]) chunk->min[i] = min[i];
+        if (max[i] > chunk->max[i]) chunk->max[i] = max[i];
+    }
+}
+
+/* bounds of every chunk from its tiles and the heights of the triangles and lines it ended up with */
+static void terrain_chunk_bounds(struct TerrainMesh *mesh) {
+    for (uint32_t i = 0; i < mesh->num_batches; i++) {
+        struct TerrainBatch *batch = &mesh->batches[i];
+        float low = FLT_MAX, high = -FLT_MAX;
+
+        for (uint32_t j = batch->first; j < batch->first + batch->count; j++) {
+            float y = batch->kind == BATCH_LINES ? mesh->line_vertices[mesh->line_indices[j]][1] : mesh->vertices[j].y;
+            low = y < low ? y : low;
+            high = y > high ? y : high;
+        }
+
+        /* every vertex of a tile lies on its corners */
+        float x = (int) (batch->chunk / TERRAIN_CHUNKS * TERRAIN_CHUNK) - 24;
+        float z = (int) (batch->chunk % TERRAIN_CHUNKS * TERRAIN_CHUNK) - 24;
+        float min[3] = { x, low, z };
+        float max[3] = { x + TERRAIN_CHUNK, high, z + TERRAIN_CHUNK };
+        terrain_chunk_extend(&mesh->chunks[batch->chunk], min, max);
+    }
+}
+
+static void terrain_tex_quad(struct TerrainMesh *mesh, struct Quad *quad, uint8_t kind, uint16_t texture,
+                             unsigned x, unsigned z, unsigned plane) {
+    static const uint8_t uv[4][2] = { { 0, 1 }, { 0, 0 }, { 1, 0 }, { 1, 1 } };
+    static const uint8_t order[6] = { 0, 1, 2, 0, 2, 3 };
+    uint8_t types[4] = { quad->a, quad->b, quad->c, quad->d };
+    const struct AtlasRegion *region = kind == BATCH_GROUND ? &ground_atlas->regions[texture]
+                                     : texture < ATLAS_MAX_IMAGES ? &wall_atlas->regions[texture]
+                                     : &wall_atlas->white;
+
+    terrain_batch(mesh, kind, x, z, plane, 6);
+    RESERVE(mesh->vertices, mesh->num_vertices, mesh->max_vertices, 6);
+
+    for (unsigned i = 0; i < 6; i++) {
+        struct RenderVertex vertex = terrain_vertex(mesh, types[order[i]], x, z, plane);
+        atlas_uv(region, uv[order[i]][0], uv[order[i]][1], &vertex.u, &vertex.v);
+        mesh->vertices[mesh->num_vertices++] = vertex;
+    }
+}
+
+/* untextured triangles are colored by the tile and sample the white texel of the ground atlas */
+static void terrain_solid(struct TerrainMesh *mesh, const uint8_t *types, unsigned count,
+                          unsigned x, unsigned z, unsigned plane) {
+    uint8_t color = mesh->source.tiles->color[plane][x][z];
+
+    terrain_batch(mesh, BATCH_GROUND, x, z, plane, count);
+    RESERVE(mesh->vertices, mesh->num_vertices, mesh->max_vertices, count);
+
+    for (unsigned i = 0; i < count; i++) {
+        struct RenderVertex vertex = terrain_vertex(mesh, types[i], x, z, plane);
+        vertex.u = ground_atlas->white.u0;
+        vertex.v = ground_atlas->white.v0;
+        vertex.r = ground_colors[color][0];
+        vertex.g = ground_colors[color][1];
+        vertex.b = ground_colors[color][2];
+        mesh->vertices[mesh->num_vertices++] = vertex;
+    }
+}
+
+/* edged tile-textures are drawn as tris instead of quads for smoother rivers, pathways, etc. */
+static void terrain_tex_crop(struct TerrainMesh *mesh, struct Quad *quad, uint8_t start,
+                             unsigned x, unsigned z, unsigned plane) {
+    static const uint8_t uv[3][2] = { { 0, 1 }, { 0, 0 }, { 1, 0 } };
+    uint8_t types[3] = { start, quad->a, quad->b };
+    const struct AtlasRegion *region = &ground_atlas->regions[mesh->source.tiles->texture[plane][x][z]];
+
+    /* texture triangle */
+    terrain_batch(mesh, BATCH_GROUND, x, z, plane, 3);
+    RESERVE(mesh->vertices, mesh->num_vertices, mesh->max_vertices, 3);
+    for (unsigned i = 0; i < 3; i++) {
+        struct RenderVertex vertex = terrain_vertex(mesh, types[i], x, z, plane);
+        atlas_uv(region, uv[i][0], uv[i][1], &vertex.u, &vertex.v);
+        mesh->vertices[mesh->num_vertices++] = vertex;
+    }
+
+    /* overlay triangle (ground floor only) */
+    if (plane == 1 || plane == 2) return;
+    uint8_t overlay[3] = { start, quad->c, quad->d };
+    terrain_solid(mesh, overlay, 3, x, z, plane);
+}
+
+#ifdef EMSCRIPTEN
+#define WIRE_SIDES 1 /* no underside *iff* using emscripten (FFP draw calls are sluggish for it) */
+#else
+#define WIRE_SIDES 2
+#endif
+
+/* wireframe lines of a tile, indexing the corner grids of its plane */
+static void terrain_wire(struct TerrainMesh *mesh, uint32_t grid, unsigned x, unsigned z, unsigned plane) {
+    /* horizontal lines 1-2, 3-4 then vertical lines 1-4, 2-3 */
+    static const uint8_t corners[8][2] = {
+        { 0, 0 }, { 0, 1 }, { 1, 1 }, { 1, 0 },
+        { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 }
+    };
+
+    terrain_batch(mesh, BATCH_LINES, x, z, plane, 8 * WIRE_SIDES);
+    RESERVE(mesh->line_indices, mesh->num_line_indices, mesh->max_line_indices, 8 * WIRE_SIDES);
+    for (unsigned side = 0; side < WIRE_SIDES; side++) {
+        for (unsigned i = 0; i < 8; i++) {
+            mesh->line_indices[mesh->num_line_indices++] = grid + side * 49 * 49
+                + (x + corners[i][0]) * 49 + z + corners[i][1];
+        }
+    }
+}
+
+static uint32_t terrain_wire_grid(struct TerrainMesh *mesh, const uint8_t corners[49][49], unsigned plane) {
+    #ifdef EMSCRIPTEN
+    static const float offsets[] = { -0.030f };
+    #else
+    /* offset to raise the wireframe slightly (on both sides) above the tiles to make it more visible */
+    static const float offsets[] = { -0.015f, 0.015f };
+    #endif
+
+    uint32_t grid = mesh->num_line_vertices;
+    unsigned count = sizeof(offsets) / sizeof(offsets[0]) * 49 * 49;
+
+    RESERVE(mesh->line_vertices, mesh->num_line_vertices, mesh->max_line_vertices, count);
+    for (unsigned side = 0; side < sizeof(offsets) / sizeof(offsets[0]); side++) {
+        for (unsigned x = 0; x < 49; x++) {
+            for (unsigned z = 0; z < 49; z++) {
+                float *vertex = mesh->line_vertices[mesh->num_line_vertices++];
+                vertex[0] = (int) x - 24;
+                vertex[1] = terrain_plane_height(plane) - corners[x][z] / 255. * mesh->options.tile_scale + offsets[side];
+                vertex[2] = (int) z - 24;
+            }
+        }
+    }
+
+    return grid;
+}
+
+static void terrain_tile_build(struct TerrainMesh *mesh, unsigned x, unsigned z, unsigned plane, uint32_t grid) {
+    const struct SectorTiles *tiles = mesh->source.tiles;
+    struct TerrainOptions *options = &mesh->options;
+    uint8_t texture = tiles->texture[plane][x][z];
+    struct Quad quad;
+
+    /* draw rooves (todo) */
+
+    /* draw walls */
+    /* skip invisible walls (only temporary until transparancy issue is fixed) */
+    uint8_t wall_east = tiles->wall_east[plane][x][z];
+    uint8_t wall_north = tiles->wall_north[plane][x][z];
+    uint16_t wall_diag = tiles->wall_diag[plane][x][z];
+    if (options->walls && wall_east != 17 && wall_north != 17 && wall_diag != 17) {
+        if (wall_east) { /*   __   */
+            quad = (struct Quad) { 1, 2, 6, 5 };
+            terrain_tex_quad(mesh, &quad, BATCH_WALL, wall_east, x, z, plane);
+        }
+
+        if (wall_north) { /*   |   */
+            quad = (struct Quad) { 1, 4, 8, 5 };
+            terrain_tex_quad(mesh, &quad, BATCH_WALL, wall_north, x, z, plane);
+        }
+
+        if (wall_diag && wall_diag < DIAG_WALL_OFFSET) { /*   /   */
+            quad = (struct Quad) { 1, 3, 7, 5 };
+            terrain_tex_quad(mesh, &quad, BATCH_WALL, wall_diag, x, z, plane);
+        }
+
+        if (wall_diag > DIAG_WALL_OFFSET && wall_diag < (DIAG_WALL_OFFSET * 2)) { /*   \   */
+            quad = (struct Quad) { 9, 10, 11, 12 };
+            terrain_tex_quad(mesh, &quad, BATCH_WALL, wall_diag % DIAG_WALL_OFFSET, x, z, plane);
+        }
+    }
+
+    if (!options->terrain) return;
+
+    if (texture) {
+        /* prevent rendering of the 'black void' texture (underground, stairs, ladders) */
+        if(texture == 8) return;
+
+        switch(options->crop ? tiles->crop[plane][x][z] : CROP_NONE) {
+            case CROP_TOP_RIGHT:
+                quad = (struct Quad) { 3, 4, 1, 4 };
+                terrain_tex_crop(mesh, &quad, 2, x, z, plane);
+                break;
+            case CROP_TOP_LEFT:
+                quad = (struct Quad) { 2, 3, 3, 4};
+                terrain_tex_crop(mesh, &quad, 1, x, z, plane);
+                break;
+            case CROP_BOTTOM_RIGHT:
+                quad = (struct Quad) { 3, 4, 2, 3 };
+                terrain_tex_crop(mesh, &quad, 1, x, z, plane);
+                break;
+            case CROP_BOTTOM_LEFT:
+                quad = (struct Quad) { 1, 4, 3, 4 };
+                terrain_tex_crop(mesh, &quad, 2, x, z, plane);
+                break;
+            default: /* no crop required (standard quad) */
+                quad = (struct Quad) { 1, 2, 3, 4 };
+                terrain_tex_quad(mesh, &quad, BATCH_GROUND, texture, x, z, plane);
+                break;
+        }
+    } else {
+        /* render non textured tiles on the ground floor and underground */
+        if(plane == 1 || plane == 2) return;
+        static const uint8_t types[6] = { 1, 2, 3, 1, 3, 4 };
+        terrain_solid(mesh, types, 6, x, z, plane);
+    }
+
+    /* render wireframe for ground floor */
+    if (options->wire_frame && (plane == 0 || plane == 3)) {
+        terrain_wire(mesh, grid, x, z, plane);
+    }
+}
+
+/* corner colors of a plane for the coarse levels, the mean of the tiles around each corner */
+static void terrain_lod_colors(struct TerrainMesh *mesh, unsigned plane, uint8_t colors[49][49][3]) {
+    static const uint8_t placeholder[3] = { ATLAS_PLACEHOLDER, ATLAS_PLACEHOLDER, ATLAS_PLACEHOLDER };
+    const struct SectorTiles *tiles = mesh->source.tiles;
+    const uint8_t *tile_colors[48][48];
+
+    /* textures stand in by their mean color, which is only there once they are all decoded */
+    for (unsigned x = 0; x < 48; x++) {
+        for (unsigned z = 0; z < 48; z++) {
+            uint8_t texture = tiles->texture[plane][x][z];
+            tile_colors[x][z] = !texture ? ground_colors[tiles->color[plane][x][z]]
+                              : ground_atlas->complete ? ground_atlas->colors[texture] : placeholder;
+        }
+    }
+
+    for (unsigned x = 0; x < 49; x++) {
+        for (unsigned z = 0; z < 49; z++) {
+            unsigned sum[3] = { 0, 0, 0 }, count = 0;
+            for (unsigned tx = x ? x - 1 : 0; tx <= x && tx < 48; tx++) {
+                for (unsigned tz = z ? z - 1 : 0; tz <= z && tz < 48; tz++) {
+                    for (unsigned c = 0; c < 3; c++) sum[c] += tile_colors[tx][tz][c];
+                    count++;
+                }
+            }
+            for (unsigned c = 0; c < 3; c++) colors[x][z][c] = sum[c] / count;
+        }
+    }
+}
+
+/*
+ * a cell of a coarse level. inner cells are a quad, cells on the chunk border fan out
+ * from their center to every tile corner along the border, as the neighbouring chunk
+ * has those at any level. lines are drawn along the cell sides the fan has.
+ */
+static void terrain_lod_cell(struct TerrainMesh *mesh, const uint8_t colors[49][49][3], uint32_t grid,
+                             int x0, int z0, int size, uint8_t lod, unsigned plane) {
+    static const int8_t steps[4][2] = { { 0, 1 }, { 1, 0 }, { 0, -1 }, { -1, 0 } };
+    int chunk_x = x0 / TERRAIN_CHUNK * TERRAIN_CHUNK, chunk_z = z0 / TERRAIN_CHUNK * TERRAIN_CHUNK;
+    uint8_t chunk = TERRAIN_CHUNK_INDEX(x0, z0);
+    /* round the cell from its first corner, along z, along x, back along z and back along x */
+    bool border[4] = {
+        x0 == chunk_x, z0 + size == chunk_z + TERRAIN_CHUNK, x0 + size == chunk_x + TERRAIN_CHUNK, z0 == chunk_z
+    };
+    int ring[4 * TERRAIN_CHUNK + 1][2];
+    uint8_t ring_side[4 * TERRAIN_CHUNK];
+    unsigned count = 0;
+    int x = x0, z = z0;
+
+    for (unsigned side = 0; side < 4; side++) {
+        int step = border[side] ? 1 : size;
+        for (int i = 0; i < size; i += step) {
+            ring[count][0] = x;
+            ring[count][1] = z;
+            ring_side[count++] = side;
+            x += steps[side][0] * step;
+            z += steps[side][1] * step;
+        }
+    }
+    ring[count][0] = x0;
+    ring[count][1] = z0;
+
+    unsigned triangles = count == 4 ? 2 : count;
+    terrain_batch_add(mesh, BATCH_GROUND, chunk, lod, triangles * 3);
+    RESERVE(mesh->vertices, mesh->num_vertices, mesh->max_vertices, triangles * 3);
+
+    for (unsigned i = 0; i < triangles; i++) {
+        int corners[3][2] = {
+            { x0 + size / 2, z0 + size / 2 }, { ring[i][0], ring[i][1] }, { ring[i + 1][0], ring[i + 1][1] }
+        };
+        if (count == 4) {
+            /* the quad as two triangles sharing its first corner */
+            memcpy(corners[0], ring[0], sizeof(corners[0]));
+            memcpy(corners[1], ring[i + 1], sizeof(corners[1]));
+            memcpy(corners[2], ring[i + 2], sizeof(corners[2]));
+        }
+
+        for (unsigned k = 0; k < 3; k++) {
+            int cx = corners[k][0], cz = corners[k][1];
+            struct RenderVertex vertex;
+            vertex.x = cx - 24;
+            vertex.z = cz - 24;
+            vertex.y = mesh->heights[plane][0][cx][cz];
+            vertex.u = ground_atlas->white.u0;
+            vertex.v = ground_atlas->white.v0;
+            vertex.r = colors[cx][cz][0];
+            vertex.g = colors[cx][cz][1];
+            vertex.b = colors[cx][cz][2];
+            vertex.a = 255;
+            mesh->vertices[mesh->num_vertices++] = vertex;
+        }
+    }
+
+    if (!mesh->options.wire_frame) return;
+
+    /* the first and last side of every cell, the other two only on the chunk border */
+    for (unsigned i = 0; i < count; i++) {
+        uint8_t side = ring_side[i];
+        if (side != 0 && side != 3 && !border[side]) continue;
+
+        terrain_batch_add(mesh, BATCH_LINES, chunk, lod, 2 * WIRE_SIDES);
+        RESERVE(mesh->line_indices, mesh->num_line_indices, mesh->max_line_indices, 2 * WIRE_SIDES);
+        for (unsigned wire = 0; wire < WIRE_SIDES; wire++) {
+            mesh->line_indices[mesh->num_line_indices++] = grid + wire * 49 * 49 + ring[i][0] * 49 + ring[i][1];
+            mesh->line_indices[mesh->num_line_indices++] = grid + wire * 49 * 49 + ring[i + 1][0] * 49 + ring[i + 1][1];
+        }
+    }
+}
+
+/* the largest height spread over the corners of a cell, which bounds how far off a coarse cell is */
+static float terrain_lod_spread(struct TerrainMesh *mesh, unsigned x0, unsigned z0, unsigned size, unsigned plane) {
+    float low = FLT_MAX, high = -FLT_MAX;
+    for (unsigned x = x0; x <= x0 + size; x++) {
+        for (unsigned z = z0; z <= z0 + size; z++) {
+            float y = mesh->heights[plane][0][x][z];
+            low = y < low ? y : low;
+            high = y > high ? y : high;
+        }
+    }
+    return high - low;
+}
+
+/* the coarse levels of every chunk of a ground floor or underground plane */
+static void terrain_lod_build(struct TerrainMesh *mesh, unsigned plane, uint32_t grid) {
+    uint8_t colors[49][49][3];
+    terrain_lod_colors(mesh, plane, colors);
+
+    for (uint8_t lod = 1; lod < TERRAIN_LODS; lod++) {
+        unsigned size = 1u << lod;
+
+        for (unsigned chunk_x = 0; chunk_x < 48; chunk_x += TERRAIN_CHUNK) {
+            for (unsigned chunk_z = 0; chunk_z < 48; chunk_z += TERRAIN_CHUNK) {
+                uint8_t index = TERRAIN_CHUNK_INDEX(chunk_x, chunk_z);
+                struct TerrainChunk *chunk = &mesh->chunks[index];
+                if (lod >= chunk->lods || mesh->detailed[plane] >> index & 1) continue;
+
+                for (unsigned x = chunk_x; x < chunk_x + TERRAIN_CHUNK; x += size) {
+                    for (unsigned z = chunk_z; z < chunk_z + TERRAIN_CHUNK; z += size) {
+                        terrain_lod_cell(mesh, colors, grid, x, z, size, lod, plane);
+
+                        /* the textures blended away count as half a cell */
+                        float error = terrain_lod_spread(mesh, x, z, size, plane);
+                        if (error < size / 2.0F) error = size / 2.0F;
+                        if (error > chunk->errors[lod]) chunk->errors[lod] = error;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*
+ * every chunk starts out empty. the upper floors keep full detail, as do the ground floor
+ * and underground chunks with a void tile, which the coarse cells would cover up.
+ */
+static void terrain_chunk_init(struct TerrainMesh *mesh) {
+    struct TerrainOptions *options = &mesh->options;
+    uint64_t all = ~0ull >> (64 - TERRAIN_CHUNKS * TERRAIN_CHUNKS);
+
+    for (unsigned plane = 0; plane < SECTOR_PLANES; plane++) {
+        bool coarse = plane == 0 || (plane == 3 && options->underground);
+        mesh->detailed[plane] = options->terrain && options->lod && coarse ? 0 : all;
+        if (mesh->detailed[plane]) continue;
+        for (unsigned x = 0; x < 48; x++) {
+            for (unsigned z = 0; z < 48; z++) {
+                if (mesh->source.tiles->texture[plane][x][z] == 8) {
+                    mesh->detailed[plane] |= 1ull << TERRAIN_CHUNK_INDEX(x, z);
+                }
+            }
+        }
+    }
+
+    uint64_t detailed = mesh->detailed[0] & mesh->detailed[3];
+    for (unsigned i = 0; i < TERRAIN_CHUNKS * TERRAIN_CHUNKS; i++) {
+        mesh->chunks[i] = (struct TerrainChunk) {
+            { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX }, detailed >> i & 1 ? 1 : TERRAIN_LODS, { 0 }
+        };
+    }
+}
+
+/* whether a built mesh has coarse levels, which are colored by the ground textures */
+bool terrain_mesh_coarse(const struct TerrainMesh *mesh) {
+    if (!mesh->built) return false;
+    for (unsigned i = 0; i < TERRAIN_CHUNKS * TERRAIN_CHUNKS; i++) {
+        if (mesh->chunks[i].lods > 1) return true;
+    }
+    return false;
+}
+
+bool terrain_mesh_stale(struct TerrainMesh *mesh, struct TerrainSource *source, struct TerrainOptions *options) {
+    return !mesh->built
+        || memcmp(&mesh->source, source, sizeof(*source)) != 0
+        || memcmp(&mesh->options, options, sizeof(*options)) != 0;
+}
+
+void terrain_mesh_build(struct TerrainMesh *mesh, struct TerrainSource *source, struct TerrainOptions *options) {
+    /* copied field by field so that padding compares equal in terrain_mesh_stale() */
+    memset(&mesh->source, 0, sizeof(mesh->source));
+    memset(&mesh->options, 0, sizeof(mesh->options));
+    mesh->source.tiles      = source->tiles;
+    mesh->source.east       = source->east;
+    mesh->source.south      = source->south;
+    mesh->source.south_east = source->south_east;
+    mesh->options.tile_scale  = options->tile_scale;
+    mesh->options.crop        = options->crop;
+    mesh->options.terrain     = options->terrain;
+    mesh->options.walls       = options->walls;
+    mesh->options.multi_story = options->multi_story;
+    mesh->options.underground = options->underground;
+    mesh->options.wire_frame  = options->wire_frame;
+    mesh->options.lod         = options->lod;
+
+    mesh->num_vertices = 0;
+    mesh->num_line_vertices = 0;
+    mesh->num_line_indices = 0;
+    mesh->num_batches = 0;
+    terrain_chunk_init(mesh);
+
+    uint8_t corners[49][49];
+
+    for (unsigned plane = 0; plane < SECTOR_PLANES; plane++) {
+        if ((plane == 1 || plane == 2) && !options->multi_story) continue;
+        if (plane == 3 && !options->underground) continue;
+
+        /* the upper floors follow the ground floor heights, the underground has its own */
+        if (plane != 1 && plane != 2) {
+            terrain_corners(source, plane, corners);
+        }
+        terrain_height_grid(mesh->heights[plane][0][0], corners[0], terrain_plane_height(plane), 0, options->tile_scale);
+        terrain_height_grid(mesh->heights[plane][1][0], corners[0], terrain_plane_height(plane), WALL_HEIGHT,
+                            options->tile_scale);
+
+        uint32_t grid = 0;
+        if (options->wire_frame && options->terrain && (plane == 0 || plane == 3)) {
+            grid = terrain_wire_grid(mesh, corners, plane);
+        }
+
+        /* chunk by chunk, so that the lines of a chunk are contiguous too */
+        for (unsigned chunk_x = 0; chunk_x < 48; chunk_x += TERRAIN_CHUNK) {
+            for (unsigned chunk_z = 0; chunk_z < 48; chunk_z += TERRAIN_CHUNK) {
+                for (unsigned x = chunk_x; x < chunk_x + TERRAIN_CHUNK; x++) {
+                    for (unsigned z = chunk_z; z < chunk_z + TERRAIN_CHUNK; z++) {
+                        terrain_tile_build(mesh, x, z, plane, grid);
+                    }
+                }
+            }
+        }
+
+        if (options->terrain && (plane == 0 || plane == 3)) {
+            terrain_lod_build(mesh, plane, grid);
+        }
+    }
+
+    terrain_sort_batches(mesh);
+    terrain_chunk_bounds(mesh);
+
+    mesh->built = true;
+}
+
+void terrain_mesh_cleanup(struct TerrainMesh *mesh) {
+    free(mesh->vertices);
+    free(mesh->line_vertices);
+    free(mesh->line_indices);
+    free(mesh->batches);
+    free(mesh->scratch);
+    memset(mesh, 0, sizeof(*mesh));
+}
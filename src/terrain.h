@@ -0,0 +1,93 @@
+#ifndef TERRAIN_H_INCLUDED
+#define TERRAIN_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "atlas.h"
+#include "render.h"
+#include "sector.h"
+
+#define WALL_HEIGHT         100
+#define DIAG_WALL_OFFSET    12000
+
+/* sectors are culled in square chunks of tiles, indexed [x][z] */
+#define TERRAIN_CHUNK       8
+#define TERRAIN_CHUNKS      (48 / TERRAIN_CHUNK) /* per side of a sector */
+#define TERRAIN_CHUNK_INDEX(x, z) ((x) / TERRAIN_CHUNK * TERRAIN_CHUNKS + (z) / TERRAIN_CHUNK)
+
+/*
+ * levels of detail of the ground floor and underground terrain, a chunk at level n
+ * is drawn in cells of 2^n tiles per side. past level 0 the cells are colored by
+ * their corners instead of textured. the chunk borders keep every tile corner at
+ * any level, so neighbouring chunks meet without cracks whatever their levels. that
+ * border is most of a chunk past cells of 4, so there is no level with cells of 8.
+ */
+#define TERRAIN_LODS        3
+#define TERRAIN_LOD_ALL     TERRAIN_LODS /* batches drawn whatever the level: walls, upper floors */
+
+/* batches of a built mesh are ordered by kind, then by level (TERRAIN_LOD_ALL first), then by chunk */
+enum BatchKind {
+    BATCH_GROUND, /* triangles in the ground atlas, untextured ones sample its white texel */
+    BATCH_WALL,   /* triangles in the wall atlas */
+    BATCH_LINES   /* wireframe, indexes line_vertices */
+};
+
+struct TerrainBatch {
+    uint8_t kind, chunk, lod;
+    uint32_t first, count;
+};
+
+/* bounds of all a chunk draws in sector space, min above max while it is empty */
+struct TerrainChunk {
+    float min[3], max[3];
+    uint8_t lods;                /* levels built, 1 where no plane of the chunk has coarse ones */
+    float errors[TERRAIN_LODS];  /* how far off each level may be: its largest cell height spread, at least half a cell */
+};
+
+/* the sector a mesh is built from plus the neighbours its seams are stitched to */
+struct TerrainSource {
+    const struct SectorTiles *tiles;
+    const struct SectorTiles *east;       /* next sector along x, NULL past the window */
+    const struct SectorTiles *south;      /* next sector along y */
+    const struct SectorTiles *south_east;
+};
+
+struct TerrainOptions {
+    float tile_scale;
+    bool crop, terrain, walls, multi_story, underground, wire_frame;
+    bool lod; /* build the coarse levels of the ground floor and underground */
+};
+
+/* retained geometry of one sector, rebuilt only when its source or options change */
+struct TerrainMesh {
+    struct RenderVertex *vertices;
+    uint32_t num_vertices, max_vertices;
+    float (*line_vertices)[3];
+    uint32_t num_line_vertices, max_line_vertices;
+    uint16_t *line_indices;
+    uint32_t num_line_indices, max_line_indices;
+    struct TerrainBatch *batches;
+    uint32_t num_batches, max_batches;
+
+    struct RenderVertex *scratch; /* staging for sorting the batches */
+    uint32_t max_scratch;
+
+    struct TerrainChunk chunks[TERRAIN_CHUNKS * TERRAIN_CHUNKS];
+    uint64_t detailed[SECTOR_PLANES]; /* bit per chunk a plane keeps at full detail whatever the level */
+
+    /* corner heights of every plane built, [plane][wall top][x][z], set up before its tiles */
+    float heights[SECTOR_PLANES][2][49][49];
+
+    struct TerrainSource source;
+    struct TerrainOptions options;
+    bool built;
+};
+
+void terrain_init(const struct TextureAtlas *ground, const struct TextureAtlas *wall);
+bool terrain_mesh_stale(struct TerrainMesh *mesh, struct TerrainSource *source, struct TerrainOptions *options);
+bool terrain_mesh_coarse(const struct TerrainMesh *mesh);
+void terrain_mesh_build(struct TerrainMesh *mesh, struct TerrainSource *source, struct TerrainOptions *options);
+void terrain_mesh_cleanup(struct TerrainMesh *mesh);
+void terrain_chunk_extend(struct TerrainChunk *chunk, const float *min, const float *max);
+
+#endif // TERRAIN_H_INCLUDED
@@ -4,14 +4,8 @@
 #include <stdio.h>
 #include <string.h>
 
-#ifdef EMSCRIPTEN
-    #include <GLFW/glfw3.h>
-#elif __APPLE__
-    #include <OpenGL/gl.h>
-#else
-    #include <GL/gl.h>
-#endif
-
+#include "atlas.h"
+#include "jobs.h"
 #include "util.h"
 #include "texture.h"
 
@@ -19,105 +13,223 @@
   #include "stb/stb_image.h"
 #endif
 
-void texture_load_dir(const char *dirname, uint32_t *textures, GLboolean transparent) {
-    DIR *dp = opendir(dirname);
-
-    if (!dp) {
-        ABORT("cannot open directory: %s", dirname);
-    }
+/* an image waiting to be decoded into its cell of an atlas */
+struct TextureJob {
+    struct TextureAtlas *atlas;
+    struct AtlasImage image;
+    char *path;
+};
 
-    struct dirent *dir;
+static struct TextureJob pending[TEXTURE_MAX_PENDING];
+static unsigned num_pending;
+static struct JobBatch *batch;
 
-    while((dir = readdir(dp))) {
-        /* ensure no system files are loaded */
-        if(/*dir->d_type == DT_REG && */dir->d_name[0] != '.') {
-            char *path = concat(dirname, dir->d_name);
-            char temp[32];
-            strcpy(temp, path);
+#ifndef EMSCRIPTEN
+/* reads and checks a bitmap header, leaves the file at the end of it */
+static void bitmap_header(FILE *fp, const char *fname, uint32_t *offset, int *w, int *h, unsigned *bpp) {
+    unsigned char header[54];
 
-            /* remove file extension */
-            char *e = strrchr(temp, '.');
-            size_t index = (int) (e - temp);
-            temp[index] = '\0';
+    if(fread(header, 1, 54, fp) != 54) {
+        ABORT("invalid bitmap header: %s", fname);
+    }
 
-            /* extract the id from the file path */
-            int id = atoi(basename(temp));
+    if(header[0] != 'B' || header[1] != 'M') {
+        ABORT("texture not in bitmap format: %s", fname);
+    }
 
-            textures[id] = texture_load(path, transparent);
+    *offset = get_le32(header + 0x0A);
+    *w = (int32_t) get_le32(header + 0x12);
+    *h = (int32_t) get_le32(header + 0x16);
+    *bpp = get_le16(header + 0x1C) / 8; /* 3 -> 24 bpp, 4 -> 32 bpp (alpha channel) */
 
-            free(path);
-        }
+    if((*bpp != 3 && *bpp != 4) || *w <= 0 || *h <= 0) {
+        ABORT("unsupported bitmap format: %s", fname);
     }
-    closedir(dp);
 }
+#endif
 
-uint32_t texture_load(const char *fname, GLboolean transparent) {
-    uint32_t texture;
+/* reads only as much of a texture as it takes to know its size */
+void texture_size(const char *fname, uint16_t *width, uint16_t *height) {
+    #ifdef EMSCRIPTEN
+    int w, h, comp;
+    if(!stbi_info(fname, &w, &h, &comp)) {
+        ABORT("cannot read texture: %s", fname);
+    }
+    #else
+    FILE *fp = fopen(fname, "rb");
+    if(!fp) {
+        ABORT("cannot open file: %s", fname);
+    }
 
+    uint32_t offset;
+    int w, h;
+    unsigned bpp;
+    bitmap_header(fp, fname, &offset, &w, &h, &bpp);
+    fclose(fp);
+    #endif
+
+    *width = w;
+    *height = h;
+}
+
+/* decodes a texture to rgba with its rows as stored, opaque families ignore any alpha */
+uint8_t* texture_decode(const char *fname, uint16_t *width, uint16_t *height, bool transparent) {
     #ifdef EMSCRIPTEN
-    int width, height, comp;
-    unsigned char* image = stbi_load(fname, &width, &height, &comp, !transparent ? STBI_rgb : STBI_rgb_alpha);
+    int w, h, comp;
+    unsigned char* image = stbi_load(fname, &w, &h, &comp, STBI_rgb_alpha);
 
     if(image == NULL) {
         fprintf(stderr, "stbi_load: Failed to load texture (%s)", fname);
         exit(EXIT_FAILURE);
     }
 
-    glGenTextures(1, &texture);
+    size_t size = (size_t) w * h * 4;
+    uint8_t *pixels = xmalloc(size);
+    memcpy(pixels, image, size);
+    stbi_image_free(image);
 
-    glBindTexture(GL_TEXTURE_2D, texture);
+    #else
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    FILE *fp = fopen(fname, "rb");
 
-    if(comp == 3)
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-    else if(comp == 4)
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+    if(!fp) {
+        ABORT("cannot open file: %s", fname);
+    }
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    uint32_t offset;
+    int w, h;
+    unsigned bpp;
+    bitmap_header(fp, fname, &offset, &w, &h, &bpp);
 
-    stbi_image_free(image);
+    size_t stride = ((size_t) w * bpp + 3) & ~(size_t) 3;
+    uint8_t *data = xmalloc(stride * h);
+    if(fseek(fp, offset, SEEK_SET) != 0 || fread(data, 1, stride * h, fp) != stride * h) {
+        ABORT("truncated bitmap: %s", fname);
+    }
+    fclose(fp);
 
-    return texture;
+    /* bgr(a) to rgba */
+    uint8_t *pixels = xmalloc((size_t) w * h * 4);
+    for(int y = 0; y < h; y++) {
+        const uint8_t *src = data + y * stride;
+        uint8_t *dst = pixels + (size_t) y * w * 4;
+        for(int x = 0; x < w; x++, src += bpp, dst += 4) {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+            dst[3] = bpp == 4 ? src[3] : 255;
+        }
+    }
+    free(data);
+    #endif
 
-    #else
+    if(!transparent) {
+        for(size_t i = 3; i < (size_t) w * h * 4; i += 4) pixels[i] = 255;
+    }
 
-    FILE *fp = fopen(fname, "rb");
-    unsigned char header[54];
+    *width = w;
+    *height = h;
+    return pixels;
+}
 
-    if(!fp) {
-        ABORT("cannot open file: %s", fname);
+/* decodes one pending image straight into its cell, runs on any of the decode threads */
+static void texture_job(void *data, unsigned index) {
+    struct TextureJob *job = &((struct TextureJob*) data)[index];
+    uint16_t width, height;
+
+    job->image.pixels = texture_decode(job->path, &width, &height, job->atlas->transparent);
+    if (width != job->image.width || height != job->image.height) {
+        ABORT("texture changed size while loading: %s", job->path);
     }
 
-    if(fread(header, 1, 54, fp) != 54) {
-        ABORT("invalid bitmap header: %s", fname);
+    atlas_blit(job->atlas, &job->image);
+    atlas_average(job->atlas, &job->image);
+    free(job->image.pixels);
+    job->image.pixels = NULL;
+}
+
+/*
+ * lays out every texture of a directory, named by id, in a single atlas. only the
+ * sizes are read here, the images are queued for texture_decode_start() and the
+ * atlas holds placeholders until then.
+ */
+void texture_load_atlas(const char *dirname, struct TextureAtlas *atlas, bool transparent) {
+    DIR *dp = opendir(dirname);
+
+    if (!dp) {
+        ABORT("cannot open directory: %s", dirname);
     }
 
-    if(header[0] != 'B' || header[1] != 'M') {
-        ABORT("texture not in bitmap format: %s", fname);
+    struct AtlasImage images[ATLAS_MAX_IMAGES];
+    char *paths[ATLAS_MAX_IMAGES] = { NULL };
+    unsigned count = 0;
+    struct dirent *dir;
+
+    while((dir = readdir(dp))) {
+        /* ensure no system files are loaded */
+        if(/*dir->d_type == DT_REG && */dir->d_name[0] != '.') {
+            char *path = concat(dirname, dir->d_name);
+            char temp[32];
+            strcpy(temp, dir->d_name);
+
+            /* remove file extension */
+            char *e = strrchr(temp, '.');
+            if (e) *e = '\0';
+
+            /* extract the id from the file name */
+            int id = atoi(temp);
+            if (id < 0 || id >= ATLAS_MAX_IMAGES || count == ATLAS_MAX_IMAGES) {
+                ABORT("texture id out of range: %s", path);
+            }
+            if (paths[id]) {
+                ABORT("texture id used twice: %s", path);
+            }
+
+            images[count].id = id;
+            images[count].pixels = NULL;
+            texture_size(path, &images[count].width, &images[count].height);
+            paths[id] = path;
+            count++;
+        }
     }
+    closedir(dp);
 
-    size_t width  = *(int*) & (header[0x12]);
-    size_t height = *(int*) & (header[0x16]);
-    size_t size   = width * height * (transparent ? 4 : 3); /* 3 -> 24 bpp, 4 -> 32 bpp (alpha channel) */
+    if (num_pending + count > TEXTURE_MAX_PENDING) {
+        ABORT("too many textures queued: %s", dirname);
+    }
 
-    unsigned char *data[size];
+    atlas_layout(atlas, images, count);
+    atlas->transparent = transparent;
 
-    fread(data, 1, size, fp);
-    fclose(fp);
+    for (unsigned i = 0; i < count; i++) {
+        pending[num_pending++] = (struct TextureJob) { atlas, images[i], paths[images[i].id] };
+    }
+}
 
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-    glTexImage2D(GL_TEXTURE_2D, 0, transparent ? GL_RGBA : GL_RGB, width, height,
-        0, transparent ? GL_BGRA_EXT : GL_BGR_EXT, GL_UNSIGNED_BYTE, data);
+/* starts decoding every queued texture on the worker threads */
+void texture_decode_start(void) {
+    if (!batch && num_pending) {
+        batch = jobs_start(texture_job, pending, num_pending);
+    }
+}
 
-    return texture;
-    #endif
+/*
+ * true once when the decoding started last has finished, the atlases it filled
+ * are then marked complete. doesn't block unless asked to wait.
+ */
+bool texture_decode_finish(bool wait) {
+    if (!batch || (!wait && !jobs_finished(batch))) {
+        return false;
+    }
+
+    jobs_wait(batch);
+    batch = NULL;
+
+    for (unsigned i = 0; i < num_pending; i++) {
+        pending[i].atlas->complete = true;
+        free(pending[i].path);
+    }
+    num_pending = 0;
+
+    return true;
 }
@@ -1,9 +1,16 @@
 #ifndef TEXTURE_H_INCLUDED
 #define TEXTURE_H_INCLUDED
 
+#include <stdbool.h>
 #include <stdint.h>
+#include "atlas.h"
 
-void texture_load_dir(const char *dirname, uint32_t *textures, GLboolean transparent);
-GLuint texture_load(const char *fname, GLboolean transparent);
+#define TEXTURE_MAX_PENDING (ATLAS_MAX_IMAGES * 4) /* images queued for decoding, across all atlases */
+
+void texture_size(const char *fname, uint16_t *width, uint16_t *height);
+uint8_t* texture_decode(const char *fname, uint16_t *width, uint16_t *height, bool transparent);
+void texture_load_atlas(const char *dirname, struct TextureAtlas *atlas, bool transparent);
+void texture_decode_start(void);
+bool texture_decode_finish(bool wait);
 
 #endif // TEXTURE_H_INCLUDED
@@ -0,0 +1,86 @@
+/*
+ * events are recorded into a fixed array and only formatted and written when it
+ * fills up or the trace is closed, so recording one is a store and a clock read.
+ * a flush shows up in the trace as its own event.
+ */
+#include <stdio.h>
+#include "trace.h"
+#include "util.h"
+
+struct TraceEvent {
+    const char *name;
+    const char *arg; /* optional detail, shown as args.detail */
+    double ts;       /* ms */
+    char phase;      /* 'B'egin or 'E'nd */
+};
+
+static FILE *fp;
+static struct TraceEvent events[TRACE_BUFFER_EVENTS];
+static unsigned num_events;
+static unsigned written;
+
+static void trace_write_string(const char *str) {
+    fputc('"', fp);
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\') fputc('\\', fp);
+        if ((unsigned char) *str >= 0x20) fputc(*str, fp);
+    }
+    fputc('"', fp);
+}
+
+static void trace_flush(void) {
+    for (unsigned i = 0; i < num_events; i++) {
+        struct TraceEvent *event = &events[i];
+
+        fputs(written++ ? ",\n" : "\n", fp);
+        fputs("{\"name\":", fp);
+        trace_write_string(event->name);
+        fprintf(fp, ",\"cat\":\"mapview\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":1", event->phase, event->ts * 1000);
+        if (event->arg) {
+            fputs(",\"args\":{\"detail\":", fp);
+            trace_write_string(event->arg);
+            fputc('}', fp);
+        }
+        fputc('}', fp);
+    }
+    num_events = 0;
+}
+
+static void trace_record(const char *name, const char *arg, char phase) {
+    if (num_events == TRACE_BUFFER_EVENTS) {
+        double start = time_ms();
+        trace_flush();
+        events[num_events++] = (struct TraceEvent) { "trace_flush", NULL, start, 'B' };
+        events[num_events++] = (struct TraceEvent) { "trace_flush", NULL, time_ms(), 'E' };
+    }
+    events[num_events++] = (struct TraceEvent) { name, arg, time_ms(), phase };
+}
+
+bool trace_open(const char *fname) {
+    fp = fopen(fname, "w");
+    if (!fp) {
+        return false;
+    }
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", fp);
+    num_events = 0;
+    written = 0;
+    return true;
+}
+
+void trace_close(void) {
+    if (!fp) return;
+
+    trace_flush();
+    fputs("\n]}\n", fp);
+    fclose(fp);
+    fp = NULL;
+}
+
+void trace_begin(const char *name, const char *arg) {
+    if (fp) trace_record(name, arg, 'B');
+}
+
+void trace_end(const char *name) {
+    if (fp) trace_record(name, NULL, 'E');
+}
@@ -0,0 +1,18 @@
+#ifndef TRACE_H_INCLUDED
+#define TRACE_H_INCLUDED
+
+#include <stdbool.h>
+
+#define TRACE_BUFFER_EVENTS 8192 /* events held before they are written out */
+
+/*
+ * chrome trace_event output (load the file in chrome://tracing or perfetto).
+ * off unless trace_open() succeeded, main thread only. names and args are
+ * stored by pointer, so they must outlive the trace.
+ */
+bool trace_open(const char *fname);
+void trace_close(void);
+void trace_begin(const char *name, const char *arg);
+void trace_end(const char *name);
+
+#endif // TRACE_H_INCLUDED
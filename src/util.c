@@ -1,6 +1,16 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#if !defined(_WIN32) && !defined(EMSCRIPTEN)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define HAVE_MMAP
+#endif
+
 #include "util.h"
 
 void* xmalloc(size_t size) {
@@ -11,6 +21,16 @@ void* xmalloc(size_t size) {
     return ptr;
 }
 
+double time_ms(void) {
+    struct timespec ts;
+    #ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+    #else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    #endif
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
 struct Point3D coordinates_to_sector(uint16_t x, uint16_t y) {
     unsigned sect_x = 0;
     unsigned sect_y = 0;
@@ -39,6 +59,65 @@ long file_length(FILE *fp) {
     return len;
 }
 
+/* maps a whole file read-only into memory, returns NULL if it cannot be opened */
+void* map_file(const char *fname, size_t *length) {
+    #ifdef HAVE_MMAP
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); /* the mapping keeps its own reference to the file */
+
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    *length = st.st_size;
+    return data;
+
+    #else
+    /* no mmap (windows, emscripten's MEMFS): read the file into one heap block instead */
+    FILE *fp = fopen(fname, "rb");
+    if (!fp) {
+        return NULL;
+    }
+
+    long len = file_length(fp);
+    if (len <= 0) {
+        fclose(fp);
+        return NULL;
+    }
+
+    void *data = xmalloc(len);
+    if (fread(data, len, 1, fp) != 1) {
+        free(data);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+
+    *length = len;
+    return data;
+    #endif
+}
+
+void unmap_file(void *data, size_t length) {
+    if (!data) return;
+    #ifdef HAVE_MMAP
+    munmap(data, length);
+    #else
+    free(data);
+    #endif
+}
+
 char* concat(const char *s1, const char *s2) {
     char *res = malloc(strlen(s1) + strlen(s2) + 1);
     strcpy(res, s1);
@@ -133,3 +212,11 @@ char** split(char* str, const char c) {
 
     return result;
 }
+
+uint16_t get_le16(const uint8_t *bytes) {
+    return bytes[0] | (bytes[1] << 8);
+}
+
+uint32_t get_le32(const uint8_t *bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
@@ -1,6 +1,7 @@
 #ifndef UTIL_H_INCLUDED
 #define UTIL_H_INCLUDED
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 
@@ -14,9 +15,14 @@ struct Point3D {
 } while(0)
 
 void* xmalloc(size_t size);
+double time_ms(void); /* milliseconds on a monotonic clock where there is one, for timing */
 ssize_t readline(char **lineptr, size_t *n, FILE *stream); /* reimplementation of 'getline' for windows support */
 struct Point3D coordinates_to_sector(uint16_t x, uint16_t y);
 long file_length(FILE *fp);
+void* map_file(const char *fname, size_t *length);
+void unmap_file(void *data, size_t length);
+uint16_t get_le16(const uint8_t *bytes);
+uint32_t get_le32(const uint8_t *bytes);
 char* concat(const char *s1, const char *s2);
 char** split(char* str, const char c);
 
@@ -0,0 +1,566 @@
+/*
+ * the world as it is drawn: the model definitions and placements, the window of
+ * streamed sectors around the current one and the frame that draws them through
+ * a renderer. nothing in here talks to GL or the window system.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "decode.h"
+#include "jobs.h"
+#include "matrix.h"
+#include "prefetch.h"
+#include "profile.h"
+#include "texture.h"
+#include "trace.h"
+#include "world.h"
+
+Area area;
+struct TextureAtlas ground_atlas, wall_atlas, model_atlas;
+struct ModelLoc model_locs[MODEL_LOC_COUNT];
+struct Model model_defs[MODEL_DEF_COUNT];
+struct Sector sectors[STREAM_WINDOW_MAX * STREAM_WINDOW_MAX];
+struct SectorArchive archive;
+struct PlacementTable placement_table;
+struct FrameStats frame_stats;
+uint16_t num_models;
+
+/* maps, decodes and bakes one model definition, runs on any of the loader threads */
+static void model_def_load(void *data, unsigned index) {
+    const struct ModelLoc *loc = ((const struct ModelLoc**) data)[index];
+
+    char fname[64];
+    snprintf(fname, sizeof(fname), DATA_DIR "models/%s.ob3", loc->name);
+    size_t len;
+    uint8_t *file = map_file(fname, &len);
+
+    if (!file) {
+        ABORT("cannot open file: %s", fname);
+    }
+
+    if (!model_load(&model_defs[loc->id], file, len)) {
+        ABORT("corrupt model: %s", fname);
+    }
+    unmap_file(file, len);
+
+    model_bake(&model_defs[loc->id], MODEL_TEXTURES ? &model_atlas : NULL, MODEL_DEF_SCALE);
+}
+
+void world_init(const struct Renderer *renderer) {
+    trace_begin("world_init", NULL);
+
+    area.curr = (struct Point3D) { START_SECTOR_X, START_SECTOR_Y, START_SECTOR_H };
+
+    /* prefer the packed archive, otherwise sectors are read from their loose files */
+    sector_archive_open(&archive, SECTOR_ARCHIVE);
+    prefetch_init(load_sector_planes, STREAM_SLOTS);
+
+    /* lay the atlases out from the texture sizes, the images decode in the background afterwards */
+    trace_begin("texture_load_atlas", DATA_DIR "textures/ground/");
+    texture_load_atlas(DATA_DIR "textures/ground/", &ground_atlas, false);
+    trace_end("texture_load_atlas");
+    trace_begin("texture_load_atlas", DATA_DIR "textures/model/");
+    texture_load_atlas(DATA_DIR "textures/model/", &model_atlas, false);
+    trace_end("texture_load_atlas");
+    trace_begin("texture_load_atlas", DATA_DIR "textures/wall/");
+    texture_load_atlas(DATA_DIR "textures/wall/", &wall_atlas, true);
+    trace_end("texture_load_atlas");
+
+    /* the placeholders go up before any worker blits into the pixels being read */
+    trace_begin("atlas_upload", renderer->name);
+    renderer->upload(&ground_atlas);
+    renderer->upload(&model_atlas);
+    renderer->upload(&wall_atlas);
+    trace_end("atlas_upload");
+    texture_decode_start();
+
+    /* model load routine, from the compiled placement table if there is one */
+    trace_begin("model_locs", MODEL_LOC_TABLE);
+    unsigned n;
+    if (placement_table_open(&placement_table, MODEL_LOC_TABLE)) {
+        n = placement_table_read(&placement_table, model_locs, MODEL_LOC_COUNT);
+    } else {
+        n = placement_load_csv(MODEL_LOC_FILE, model_locs, MODEL_LOC_COUNT);
+    }
+    trace_end("model_locs");
+
+    /* queue the first placement of every model in use, each job fills its own model_defs slot */
+    trace_begin("model_load", NULL);
+    bool queued[MODEL_DEF_COUNT] = { false };
+    const struct ModelLoc *jobs[MODEL_DEF_COUNT];
+    unsigned num_jobs = 0;
+
+    for (unsigned i = 0; i < n; i++) {
+        struct ModelLoc *loc = &model_locs[i];
+
+        if (loc->id >= MODEL_DEF_COUNT) {
+            ABORT("model id %u out of range: %s", loc->id, loc->name);
+        }
+
+        if (!queued[loc->id]) {
+            queued[loc->id] = true;
+            jobs[num_jobs++] = loc;
+        }
+    }
+
+    jobs_run(model_def_load, jobs, num_jobs);
+    trace_end("model_load");
+
+    /* bucket the placements by sector so streaming a sector in only visits its own */
+    trace_begin("placement_index_build", NULL);
+    placement_index_build(model_locs, n);
+    trace_end("placement_index_build");
+
+    terrain_init(&ground_atlas, &wall_atlas);
+
+    trace_end("world_init");
+}
+
+/* replaces the placeholder atlases once every texture is decoded, call it on the renderer's thread */
+void world_load_textures(const struct Renderer *renderer, bool wait) {
+    if (texture_decode_finish(wait)) {
+        trace_begin("atlas_upload", renderer->name);
+        renderer->upload(&ground_atlas);
+        renderer->upload(&model_atlas);
+        renderer->upload(&wall_atlas);
+        trace_end("atlas_upload");
+
+        /* only the coarse terrain is colored by the textures, which were placeholders until now */
+        for (unsigned i = 0; i < STREAM_WINDOW_MAX * STREAM_WINDOW_MAX; i++) {
+            if (terrain_mesh_coarse(&sectors[i].mesh)) sectors[i].mesh.built = false;
+        }
+    }
+}
+
+void world_cleanup(void) {
+    texture_decode_finish(true);
+    for (unsigned i = 0; i < MODEL_DEF_COUNT; i++) {
+        model_cleanup(&model_defs[i]);
+    }
+    for (unsigned i = 0; i < STREAM_WINDOW_MAX * STREAM_WINDOW_MAX; i++) {
+        terrain_mesh_cleanup(&sectors[i].mesh);
+    }
+    prefetch_shutdown();
+    sector_archive_close(&archive);
+    placement_table_close(&placement_table);
+}
+
+/* centers the window on the given sector, false if that sector doesn't exist */
+bool world_open(struct Point3D *point, unsigned window_size) {
+    area.loaded = false;
+
+    trace_begin("stream_window", NULL);
+    stream_window(point, window_size);
+    trace_end("stream_window");
+
+    if (!area.window[area.size / 2][area.size / 2]) {
+        return false;
+    }
+
+    /* start decoding the border around the window while it's on screen */
+    prefetch_request(point->x, point->y, area.size / 2 + 1);
+
+    num_models = 0;
+    for (unsigned wx = 0; wx < area.size; wx++) {
+        for (unsigned wz = 0; wz < area.size; wz++) {
+            if (area.window[wx][wz]) num_models += area.window[wx][wz]->num_models;
+        }
+    }
+
+    area.curr = *point;
+    area.loaded = true;
+    return true;
+}
+
+/* the orbiting camera around the window center, zoom is the distance along the view axis */
+void world_camera(struct WorldView *view, float angle_x, float angle_y, float zoom, unsigned width, unsigned height) {
+    mat4_perspective(view->projection, FIELD_OF_VIEW, width / (float) height, 0.1, DRAW_DISTANCE);
+    view->focal_pixels = view->projection[5] * height / 2;
+
+    mat4_identity(view->modelview);
+    mat4_translate(view->modelview, 0, 0, zoom);
+    mat4_rotate(view->modelview, angle_y, 1, 0, 0);
+    mat4_rotate(view->modelview, angle_x, 0, 1, 0);
+    mat4_rotate(view->modelview, 180, 0, 0, 1);
+
+    /* the view only rotates and translates, so the eye is the translation rotated back */
+    const float *m = view->modelview;
+    for (unsigned i = 0; i < 3; i++) {
+        view->eye[i] = -(m[i * 4] * m[12] + m[i * 4 + 1] * m[13] + m[i * 4 + 2] * m[14]);
+    }
+}
+
+void world_draw(const struct Renderer *renderer, struct WorldView *view) {
+    /* cull whole sectors of the window against the view, then the chunks of the ones left */
+    struct Frustum frustum;
+    frustum_extract(&frustum, view->projection, view->modelview);
+
+    struct DrawSector visible[STREAM_WINDOW_MAX * STREAM_WINDOW_MAX];
+    frame_stats = (struct FrameStats) { 0 };
+    int radius = area.size / 2;
+
+    profile_begin(PHASE_PREPARE);
+
+    for (unsigned wx = 0; wx < area.size; wx++) {
+        for (unsigned wz = 0; wz < area.size; wz++) {
+            struct Sector *sector = area.window[wx][wz];
+            float off_x = ((int) wx - radius) * 48.0F;
+            float off_z = ((int) wz - radius) * 48.0F;
+
+            if (!sector || !sector_visible(&frustum, off_x, off_z)) continue;
+
+            sector_prepare(sector, wx, wz, &view->terrain);
+
+            struct DrawSector *draw = &visible[frame_stats.visible_sectors++];
+            *draw = (struct DrawSector) { .sector = sector, .off_x = off_x, .off_z = off_z };
+            draw->chunks = sector_chunks_visible(&frustum, sector, off_x, off_z);
+            sector_chunk_lods(view, draw);
+            memcpy(draw->modelview, view->modelview, sizeof(draw->modelview));
+            mat4_translate(draw->modelview, off_x, 0, off_z);
+        }
+    }
+    profile_end(PHASE_PREPARE);
+
+    renderer->begin();
+
+    terrain_draw(renderer, view, visible, frame_stats.visible_sectors);
+
+    /* draw object models */
+    if (view->models) {
+        profile_begin(PHASE_MODELS);
+        renderer->texture(MODEL_TEXTURES ? &model_atlas : NULL);
+        frame_stats.state_changes++;
+
+        for (unsigned i = 0; i < frame_stats.visible_sectors; i++) {
+            sector_draw_models(renderer, view, &visible[i]);
+        }
+        profile_end(PHASE_MODELS);
+    }
+
+    renderer->end();
+}
+
+/* where a placed model stands in sector space and which way it is turned */
+static void model_position(const struct TerrainMesh *mesh, const struct ModelLoc *loc, float *pos, float *angle) {
+    unsigned x = loc->x % 48, z = loc->y % 48;
+    float tile_scale = mesh->options.tile_scale;
+    *angle = loc->dir < 8 ? loc->dir * 45 : 0;
+
+    /* used to minorly adjust models to be in the middle of the appropriate tile */
+    float factor = tile_scale / 7.0F;
+    float x_off = factor;
+    float z_off = factor;
+    // todo: handle diagonals
+    if(loc->dir == 2 || loc->dir == 6) {
+        z_off += (loc->width * factor) - factor;
+        x_off += (loc->height * factor) - factor;
+    } else if(loc->dir == 0 || loc->dir == 4) {
+        x_off += (loc->width * factor) - factor;
+        z_off += (loc->height * factor) - factor;
+    }
+
+    pos[0] = (int) x - 24 + x_off;
+    pos[1] = mesh->heights[0][0][x][z];
+    pos[2] = (int) z - 24 + z_off;
+}
+
+/* grows the chunks of a freshly built mesh to take in the models standing on them */
+static void sector_model_bounds(struct Sector *sector) {
+    for (unsigned i = 0; i < sector->num_models; i++) {
+        struct ModelLoc *loc = &sector->placements[i];
+        struct Model *model = &model_defs[loc->id];
+        if (!model->mesh_count) continue;
+
+        float pos[3], angle;
+        model_position(&sector->mesh, loc, pos, &angle);
+        float min[3] = { pos[0] - model->radius, pos[1] + model->min_y, pos[2] - model->radius };
+        float max[3] = { pos[0] + model->radius, pos[1] + model->max_y, pos[2] + model->radius };
+        terrain_chunk_extend(&sector->mesh.chunks[TERRAIN_CHUNK_INDEX(loc->x % 48, loc->y % 48)], min, max);
+    }
+}
+
+void sector_prepare(struct Sector *sector, unsigned wx, unsigned wz, struct TerrainOptions *options) {
+    struct TerrainSource source = window_source(wx, wz);
+
+    /* geometry is only regenerated when the sector, its neighbours or the options change */
+    if (terrain_mesh_stale(&sector->mesh, &source, options)) {
+        trace_begin("terrain_mesh_build", NULL);
+        terrain_mesh_build(&sector->mesh, &source, options);
+        sector_model_bounds(sector);
+        trace_end("terrain_mesh_build");
+    }
+}
+
+/* draws a placed model from its baked mesh */
+static void model_draw(const struct Renderer *renderer, struct WorldView *view, struct DrawSector *visible,
+                       struct Model *model, struct ModelLoc *loc) {
+    if (!model->mesh_count) return;
+
+    float pos[3], angle;
+    model_position(&visible->sector->mesh, loc, pos, &angle);
+
+    float modelview[16];
+    memcpy(modelview, visible->modelview, sizeof(modelview));
+    mat4_translate(modelview, pos[0], pos[1], pos[2]);
+    mat4_rotate(modelview, angle, 0, 1, 0);
+
+    renderer->transform(view->projection, modelview);
+    renderer->triangles(model->mesh, model->mesh_count);
+    frame_stats.draw_calls++;
+    frame_stats.triangles += model->mesh_count / 3;
+}
+
+void sector_draw_models(const struct Renderer *renderer, struct WorldView *view, struct DrawSector *visible) {
+    struct Sector *sector = visible->sector;
+    for (unsigned i = 0; i < sector->num_models; i++) {
+        struct ModelLoc *loc = &sector->placements[i];
+        if (!(visible->chunks >> TERRAIN_CHUNK_INDEX(loc->x % 48, loc->y % 48) & 1)) continue;
+        model_draw(renderer, view, visible, &model_defs[loc->id], loc);
+    }
+}
+
+static bool terrain_batch_drawn(const struct DrawSector *visible, const struct TerrainBatch *batch) {
+    return (visible->chunks >> batch->chunk & 1)
+        && (batch->lod == TERRAIN_LOD_ALL || batch->lod == visible->lods[batch->chunk]);
+}
+
+/*
+ * draws the batches of a kind from the cursor on, leaving out the culled chunks and
+ * the levels of detail not picked. batches drawn that follow each other in the mesh
+ * go in one call.
+ */
+static void terrain_draw_kind(const struct Renderer *renderer, struct WorldView *view, struct DrawSector *visible,
+                              uint8_t kind) {
+    static const uint8_t wire_color[4] = { 0, 0, 0, 255 };
+    struct TerrainMesh *mesh = &visible->sector->mesh;
+    bool transformed = false;
+
+    while (visible->cursor < mesh->num_batches && mesh->batches[visible->cursor].kind == kind) {
+        struct TerrainBatch *batch = &mesh->batches[visible->cursor++];
+        if (!terrain_batch_drawn(visible, batch)) continue;
+
+        uint32_t first = batch->first, count = batch->count;
+        while (visible->cursor < mesh->num_batches) {
+            struct TerrainBatch *next = &mesh->batches[visible->cursor];
+            if (next->kind != kind || !terrain_batch_drawn(visible, next) || next->first != first + count) break;
+            count += next->count;
+            visible->cursor++;
+        }
+
+        if (!transformed) {
+            renderer->transform(view->projection, visible->modelview);
+            transformed = true;
+        }
+        if (kind == BATCH_LINES) {
+            renderer->lines(mesh->line_vertices, mesh->line_indices + first, count, wire_color);
+            frame_stats.lines += count / 2;
+        } else {
+            renderer->triangles(mesh->vertices + first, count);
+            frame_stats.triangles += count / 3;
+        }
+        frame_stats.draw_calls++;
+    }
+}
+
+void terrain_draw(const struct Renderer *renderer, struct WorldView *view, struct DrawSector *visible, unsigned count) {
+    /* meshes are sorted by atlas, so each atlas is bound once per frame */
+    for (uint8_t kind = BATCH_GROUND; kind < BATCH_LINES; kind++) {
+        enum ProfilePhase phase = kind == BATCH_GROUND ? PHASE_GROUND : PHASE_WALLS;
+        profile_begin(phase);
+        renderer->texture(kind == BATCH_GROUND ? &ground_atlas : &wall_atlas);
+        frame_stats.state_changes++;
+
+        for (unsigned i = 0; i < count; i++) {
+            terrain_draw_kind(renderer, view, &visible[i], kind);
+        }
+        profile_end(phase);
+    }
+
+    renderer->texture(NULL);
+
+    /* wireframe */
+    profile_begin(PHASE_WIREFRAME);
+    for (unsigned i = 0; i < count; i++) {
+        terrain_draw_kind(renderer, view, &visible[i], BATCH_LINES);
+    }
+    profile_end(PHASE_WIREFRAME);
+}
+
+/* the window sector at (wx, wz) with the neighbours its seams are stitched to */
+struct TerrainSource window_source(unsigned wx, unsigned wz) {
+    struct TerrainSource source = { NULL, NULL, NULL, NULL };
+    bool east  = wx + 1 < area.size;
+    bool south = wz + 1 < area.size;
+
+    source.tiles = area.window[wx][wz]->tiles;
+    if (east && area.window[wx + 1][wz])                   source.east       = area.window[wx + 1][wz]->tiles;
+    if (south && area.window[wx][wz + 1])                  source.south      = area.window[wx][wz + 1]->tiles;
+    if (east && south && area.window[wx + 1][wz + 1])      source.south_east = area.window[wx + 1][wz + 1]->tiles;
+
+    return source;
+}
+
+/* tests the bounds of a window sector drawn at the given offset */
+bool sector_visible(struct Frustum *frustum, float off_x, float off_z) {
+    float min[3] = { off_x - 24, -SECTOR_MAX_EXTENT, off_z - 24 };
+    float max[3] = { off_x + 24,  SECTOR_MAX_EXTENT, off_z + 24 };
+    return frustum_test_box(frustum, min, max);
+}
+
+/* the chunks of a prepared sector inside the view, counted into the frame stats */
+uint64_t sector_chunks_visible(struct Frustum *frustum, struct Sector *sector, float off_x, float off_z) {
+    uint64_t visible = 0;
+
+    for (unsigned i = 0; i < TERRAIN_CHUNKS * TERRAIN_CHUNKS; i++) {
+        const struct TerrainChunk *chunk = &sector->mesh.chunks[i];
+        if (chunk->min[0] > chunk->max[0]) continue;
+
+        float min[3] = { chunk->min[0] + off_x, chunk->min[1], chunk->min[2] + off_z };
+        float max[3] = { chunk->max[0] + off_x, chunk->max[1], chunk->max[2] + off_z };
+        if (frustum_test_box(frustum, min, max)) {
+            visible |= (uint64_t) 1 << i;
+            frame_stats.visible_chunks++;
+        } else {
+            frame_stats.culled_chunks++;
+        }
+    }
+    return visible;
+}
+
+/*
+ * picks the coarsest level of every visible chunk that stays within the screen error
+ * allowed, measured at the point of the chunk nearest to the eye.
+ */
+void sector_chunk_lods(struct WorldView *view, struct DrawSector *visible) {
+    for (unsigned i = 0; i < TERRAIN_CHUNKS * TERRAIN_CHUNKS; i++) {
+        const struct TerrainChunk *chunk = &visible->sector->mesh.chunks[i];
+        visible->lods[i] = 0;
+        if (!(visible->chunks >> i & 1)) continue;
+
+        float offset[3] = { visible->off_x, 0, visible->off_z };
+        float distance = 0;
+        for (unsigned axis = 0; axis < 3; axis++) {
+            float low = chunk->min[axis] + offset[axis], high = chunk->max[axis] + offset[axis];
+            float eye = view->eye[axis];
+            float d = eye < low ? low - eye : eye > high ? eye - high : 0;
+            distance += d * d;
+        }
+        float pixels = view->focal_pixels / fmaxf(sqrtf(distance), 0.1F);
+
+        for (uint8_t lod = chunk->lods - 1; lod > 0; lod--) {
+            float error = chunk->errors[lod] * pixels;
+            if (error <= view->lod_error) {
+                visible->lods[i] = lod;
+                frame_stats.coarse_chunks++;
+                if (error > frame_stats.screen_error) frame_stats.screen_error = error;
+                break;
+            }
+        }
+    }
+}
+
+/* the raw payload of a sector plane, pointing into the archive or copied into buf; NULL if it doesn't exist */
+const uint8_t* read_sector(struct Point3D *point, uint8_t plane, uint8_t *buf) {
+    if (archive.data) {
+        return sector_archive_read(&archive, plane, point->x, point->y, buf);
+    }
+
+    char fname[32];
+
+    snprintf(fname, sizeof(fname), DATA_DIR "sectors/h%ux%uy%u", plane, point->x, point->y);
+
+    FILE *fp = fopen(fname, "rb");
+
+    if (!fp) {
+        return NULL;
+    }
+
+    size_t read = fread(buf, SECTOR_SIZE, 1, fp);
+    fclose(fp);
+    return read == 1 ? buf : NULL;
+}
+
+/* called from the prefetch worker as well, so it must only touch its arguments and the archive */
+bool load_sector(struct SectorTiles *sector, struct Point3D *point, uint8_t plane) {
+    uint8_t buf[SECTOR_SIZE];
+    const uint8_t *data = read_sector(point, plane, buf);
+
+    if (!data) {
+        return false;
+    }
+
+    /* the records are in [x][z] order like the field arrays, heights are 0 underground */
+    struct TileFields fields = {
+        sector->height[plane][0], sector->texture[plane][0], sector->color[plane][0], sector->roof[plane][0],
+        sector->wall_east[plane][0], sector->wall_north[plane][0], sector->wall_diag[plane][0]
+    };
+    decode_tiles(&fields, data, 48 * 48, plane == 3);
+    decode_crops(sector->crop[plane][0], sector->texture[plane][0]);
+    return true;
+}
+
+bool load_sector_planes(struct SectorTiles *sector, uint16_t x, uint16_t y) {
+    struct Point3D point = { x, y, 0 };
+    for (uint8_t plane = 0; plane < SECTOR_PLANES; plane++) {
+        if (!load_sector(sector, &point, plane)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* slides the window of resident sectors to be centered on the given sector */
+void stream_window(struct Point3D *point, unsigned window_size) {
+    struct Sector *next[STREAM_WINDOW_MAX][STREAM_WINDOW_MAX] = { { NULL } };
+    int size = window_size;
+    int radius = size / 2;
+
+    /* keep the sectors that are still inside the window, evict the rest */
+    for (unsigned i = 0; i < STREAM_WINDOW_MAX * STREAM_WINDOW_MAX; i++) {
+        struct Sector *sector = &sectors[i];
+        if (!sector->used) continue;
+
+        int wx = sector->pos.x - point->x + radius;
+        int wz = sector->pos.y - point->y + radius;
+
+        if (sector->pos.z == point->z && wx >= 0 && wz >= 0 && wx < size && wz < size) {
+            next[wx][wz] = sector;
+        } else {
+            prefetch_release(sector->pos.x, sector->pos.y);
+            sector->used = false;
+        }
+    }
+
+    /* and bring in the ones that entered it */
+    for (int wx = 0; wx < size; wx++) {
+        for (int wz = 0; wz < size; wz++) {
+            if (next[wx][wz]) continue;
+
+            uint16_t x = point->x + wx - radius;
+            uint16_t y = point->y + wz - radius;
+            struct SectorTiles *tiles = prefetch_acquire(x, y);
+
+            if (!tiles) continue; /* past the edge of the world */
+
+            struct Sector *sector = sectors;
+            while (sector->used) sector++;
+
+            sector->used = true;
+            sector->pos = (struct Point3D) { x, y, point->z };
+            sector->tiles = tiles;
+            sector->mesh.built = false;
+            sector_populate_models(sector);
+
+            next[wx][wz] = sector;
+        }
+    }
+
+    memcpy(area.window, next, sizeof(next));
+    area.size = size;
+}
+
+void sector_populate_models(struct Sector *sector) {
+    unsigned count;
+    sector->placements = placement_find(sector->pos.z, sector->pos.x, sector->pos.y, &count);
+    sector->num_models = count;
+}
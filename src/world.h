@@ -0,0 +1,126 @@
+#ifndef WORLD_H_INCLUDED
+#define WORLD_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "atlas.h"
+#include "frustum.h"
+#include "model.h"
+#include "placement.h"
+#include "render.h"
+#include "sector.h"
+#include "terrain.h"
+#include "util.h"
+
+#define DATA_DIR        "./data/"
+
+#define MAX_NORTH       37
+#define MAX_SOUTH       55
+#define MAX_EAST        48
+#define MAX_WEST        67
+#define TOP_FLOOR       2
+#define UNDERGROUND     3
+
+#define START_SECTOR_X  55
+#define START_SECTOR_Y  48
+#define START_SECTOR_H  0
+
+#define START_ANGLE_X   35
+#define START_ANGLE_Y   25
+#define START_ANGLE_Z  -33
+
+#define FIELD_OF_VIEW   60
+#define DRAW_DISTANCE   200
+#define LOD_ERROR       4.0F /* screen error the terrain level of detail may cause, in pixels */
+
+#define SECTOR_ARCHIVE  (DATA_DIR "sectors.pak")
+
+#define STREAM_WINDOW_MAX   5 /* largest streamed view, in sectors per side (odd) */
+#define STREAM_SLOTS        ((STREAM_WINDOW_MAX + 2) * (STREAM_WINDOW_MAX + 2)) /* window plus a prefetched border */
+#define SECTOR_MAX_EXTENT   48 /* generous vertical bounds of a sector's terrain, walls and models */
+
+#define MODEL_DEF_COUNT 405
+#define MODEL_DEF_SCALE 140.0F
+#define MODEL_LOC_COUNT 26675
+#define MODEL_LOC_FILE  (DATA_DIR "model_locs.csv")
+#define MODEL_LOC_TABLE (DATA_DIR "model_locs.bin") /* compiled from MODEL_LOC_FILE by locpack */
+#define MODEL_TEXTURES  false /* unfinished */
+
+/* a sector resident in the streamed window */
+struct Sector {
+    struct Point3D pos;
+    struct SectorTiles *tiles; /* all planes, owned by the prefetch ring */
+    struct ModelLoc *placements; /* slice of the placement index, ordered by tile */
+    uint16_t num_models;
+    struct TerrainMesh mesh;
+    bool used;
+};
+
+/* a visible sector of the window queued for drawing this frame */
+struct DrawSector {
+    struct Sector *sector;
+    float off_x, off_z;   /* translation from the window center */
+    float modelview[16];  /* the view translated by the offset */
+    uint32_t cursor;      /* next terrain batch to draw */
+    uint64_t chunks;      /* bit per terrain chunk inside the view */
+    uint8_t lods[TERRAIN_CHUNKS * TERRAIN_CHUNKS]; /* level of detail each visible chunk is drawn at */
+};
+
+typedef struct {
+    struct Sector *window[STREAM_WINDOW_MAX][STREAM_WINDOW_MAX]; /* [x][y], NULL outside the world */
+    unsigned size; /* sectors per side of the window in use */
+    struct Point3D curr;
+    bool loaded;
+} Area;
+
+/* how a frame of the world is drawn */
+struct WorldView {
+    float projection[16], modelview[16];
+    float eye[3];         /* camera position */
+    float focal_pixels;   /* a unit at distance d covers focal_pixels / d pixels */
+    float lod_error;      /* screen error allowed to the terrain level of detail in pixels, 0 keeps full detail */
+    struct TerrainOptions terrain;
+    bool models;
+};
+
+/* counters of the last frame drawn */
+struct FrameStats {
+    unsigned visible_sectors;
+    unsigned draw_calls;
+    unsigned state_changes; /* texture binds per frame */
+    unsigned visible_chunks, culled_chunks; /* of the visible sectors, empty chunks aren't counted */
+    unsigned coarse_chunks; /* visible chunks drawn below full detail */
+    unsigned triangles, lines;
+    float screen_error;     /* largest of the levels of detail drawn, in pixels */
+};
+
+extern Area area;
+extern struct TextureAtlas ground_atlas, wall_atlas, model_atlas;
+extern struct ModelLoc model_locs[MODEL_LOC_COUNT];
+extern struct Model model_defs[MODEL_DEF_COUNT];
+extern struct Sector sectors[STREAM_WINDOW_MAX * STREAM_WINDOW_MAX];
+extern struct SectorArchive archive;
+extern struct PlacementTable placement_table;
+extern struct FrameStats frame_stats;
+extern uint16_t num_models;
+
+void world_init(const struct Renderer *renderer);
+void world_load_textures(const struct Renderer *renderer, bool wait);
+void world_cleanup(void);
+bool world_open(struct Point3D *point, unsigned window_size);
+void world_camera(struct WorldView *view, float angle_x, float angle_y, float zoom, unsigned width, unsigned height);
+void world_draw(const struct Renderer *renderer, struct WorldView *view);
+void stream_window(struct Point3D *point, unsigned window_size);
+void sector_prepare(struct Sector *sector, unsigned wx, unsigned wz, struct TerrainOptions *options);
+void sector_draw_models(const struct Renderer *renderer, struct WorldView *view, struct DrawSector *visible);
+void terrain_draw(const struct Renderer *renderer, struct WorldView *view, struct DrawSector *visible, unsigned count);
+struct TerrainSource window_source(unsigned wx, unsigned wz);
+void sector_populate_models(struct Sector *sector);
+bool sector_visible(struct Frustum *frustum, float off_x, float off_z);
+uint64_t sector_chunks_visible(struct Frustum *frustum, struct Sector *sector, float off_x, float off_z);
+void sector_chunk_lods(struct WorldView *view, struct DrawSector *visible);
+const uint8_t* read_sector(struct Point3D *point, uint8_t plane, uint8_t *buf);
+bool load_sector(struct SectorTiles *sector, struct Point3D *point, uint8_t plane);
+bool load_sector_planes(struct SectorTiles *sector, uint16_t x, uint16_t y);
+
+#endif // WORLD_H_INCLUDED
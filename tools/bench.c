@@ -0,0 +1,439 @@
+/*
+ * walks every sector position of every plane and times the stages of bringing
+ * it on screen: loading its tiles, looking up its model placements, building its
+ * geometry and drawing it with the software renderer. reports p50/p95/p99 per
+ * stage as CSV or JSON, optionally with the raw samples. model decoding and
+ * every decode kernel (run over the whole sector set) are timed on their own
+ * and reported as throughput. the start view is then drawn at a few zoom levels
+ * with every terrain level of detail budget, to weigh triangles against error.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "decode.h"
+#include "raster.h"
+#include "world.h"
+
+#define POSITIONS       (SECTOR_PLANES * SECTOR_COLS * SECTOR_ROWS)
+#define DECODE_ROUNDS   20 /* times every model is decoded, the files are small */
+#define KERNEL_ROUNDS   5  /* times the whole sector set goes through every kernel */
+#define MAX_RESULTS     16
+#define LOD_FRAMES      10 /* frames drawn per zoom and error budget */
+#define LOD_ZOOMS       3
+#define LOD_ERRORS      6
+
+enum Stage {
+    STAGE_LOAD,
+    STAGE_LOOKUP,
+    STAGE_BUILD,
+    STAGE_DRAW,
+    STAGE_COUNT
+};
+
+static const char *stage_names[STAGE_COUNT] = { "load", "lookup", "build", "draw" };
+
+struct Samples {
+    double values[POSITIONS];
+    unsigned count;
+};
+
+static struct Samples samples[STAGE_COUNT];
+
+struct Throughput {
+    char name[32];
+    unsigned files, rounds;
+    size_t bytes;
+    double ms;
+};
+
+static struct Throughput results[MAX_RESULTS];
+static unsigned num_results;
+
+static const float lod_zooms[LOD_ZOOMS] = { START_ANGLE_Z, -80, -156 };
+static const float lod_errors[LOD_ERRORS] = { 0, 1, 2, 4, 8, 16 };
+
+struct LodResult {
+    float zoom, max_error, screen_error;
+    unsigned triangles, lines;
+    double ms;
+};
+
+static struct LodResult lod_results[LOD_ZOOMS * LOD_ERRORS];
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*) a, y = *(const double*) b;
+    return x < y ? -1 : x > y;
+}
+
+/* nearest rank percentile of sorted values */
+static double percentile(const struct Samples *stage, double p) {
+    if (!stage->count) return 0;
+    unsigned rank = (unsigned) (p / 100 * stage->count + 0.999999);
+    if (rank < 1) rank = 1;
+    return stage->values[rank - 1];
+}
+
+/* decodes every model definition in use from its mapped file, only model_load() is timed */
+static void decode_models(void) {
+    struct Throughput *result = &results[num_results++];
+    bool seen[MODEL_DEF_COUNT] = { false };
+    *result = (struct Throughput) { "models", 0, DECODE_ROUNDS, 0, 0 };
+
+    for (unsigned i = 0; i < MODEL_LOC_COUNT && model_locs[i].name; i++) {
+        struct ModelLoc *loc = &model_locs[i];
+        if (seen[loc->id]) continue;
+        seen[loc->id] = true;
+
+        char fname[64];
+        snprintf(fname, sizeof(fname), DATA_DIR "models/%s.ob3", loc->name);
+        size_t len;
+        uint8_t *file = map_file(fname, &len);
+        if (!file) {
+            ABORT("cannot open file: %s", fname);
+        }
+
+        for (unsigned round = 0; round < DECODE_ROUNDS; round++) {
+            struct Model model = { 0 };
+            double start = time_ms();
+            if (!model_load(&model, file, len)) {
+                ABORT("corrupt model: %s", fname);
+            }
+            result->ms += time_ms() - start;
+            model_cleanup(&model);
+        }
+
+        unmap_file(file, len);
+        result->bytes += len * DECODE_ROUNDS;
+        result->files++;
+    }
+}
+
+/* runs every kernel set the cpu supports over the raw payloads of all sector planes */
+static void decode_kernel_sets(void) {
+    uint8_t *raw = xmalloc((size_t) POSITIONS * SECTOR_SIZE);
+    uint8_t *out = xmalloc((size_t) POSITIONS * SECTOR_SIZE);
+    unsigned files = 0;
+
+    for (uint8_t plane = 0; plane < SECTOR_PLANES; plane++) {
+        for (uint16_t x = SECTOR_MIN_X; x < SECTOR_MIN_X + SECTOR_COLS; x++) {
+            for (uint16_t y = SECTOR_MIN_Y; y < SECTOR_MIN_Y + SECTOR_ROWS; y++) {
+                struct Point3D point = { x, y, plane };
+                uint8_t *dst = raw + (size_t) files * SECTOR_SIZE;
+                const uint8_t *data = read_sector(&point, plane, dst);
+                if (data) {
+                    if (data != dst) memcpy(dst, data, SECTOR_SIZE);
+                    files++;
+                }
+            }
+        }
+    }
+
+    size_t bytes = (size_t) files * SECTOR_SIZE;
+    size_t records = bytes / TILE_RECORD_SIZE;
+    struct TileFields fields = {
+        out, out + records, out + records * 2, out + records * 3, out + records * 4, out + records * 5,
+        (uint16_t*) (out + records * 6)
+    };
+    uint8_t *styles = xmalloc(records);
+    unsigned count;
+    const struct DecodeKernels *sets = decode_kernels(&count);
+
+    for (unsigned i = 0; i < count && num_results + 4 <= MAX_RESULTS; i++) {
+        const struct DecodeKernels *set = &sets[i];
+        if (!decode_supported(set)) continue;
+
+        struct Throughput *tiles = &results[num_results++];
+        struct Throughput *be16 = &results[num_results++];
+        struct Throughput *be32 = &results[num_results++];
+        struct Throughput *crops = &results[num_results++];
+        snprintf(tiles->name, sizeof(tiles->name), "tiles_%s", set->name);
+        snprintf(be16->name, sizeof(be16->name), "be16_%s", set->name);
+        snprintf(be32->name, sizeof(be32->name), "be32_%s", set->name);
+        snprintf(crops->name, sizeof(crops->name), "crops_%s", set->name);
+
+        for (unsigned round = 0; round < KERNEL_ROUNDS; round++) {
+            double start = time_ms();
+            set->tiles(&fields, raw, records, false);
+            double tiles_end = time_ms();
+            /* the planes' textures as the tiles kernel left them, before the byte swaps overwrite them */
+            for (unsigned f = 0; f < files; f++) {
+                set->crops(styles + (size_t) f * 48 * 48, fields.texture + (size_t) f * 48 * 48);
+            }
+            double crops_end = time_ms();
+            set->be16((uint16_t*) out, raw, bytes / 2);
+            double be16_end = time_ms();
+            set->be32((uint32_t*) out, raw, bytes / 4);
+            double be32_end = time_ms();
+
+            tiles->ms += tiles_end - start;
+            crops->ms += crops_end - tiles_end;
+            be16->ms += be16_end - crops_end;
+            be32->ms += be32_end - be16_end;
+        }
+
+        struct Throughput *set_results[4] = { tiles, be16, be32, crops };
+        for (unsigned r = 0; r < 4; r++) {
+            set_results[r]->files = files;
+            set_results[r]->rounds = KERNEL_ROUNDS;
+            set_results[r]->bytes = bytes * KERNEL_ROUNDS;
+        }
+        crops->bytes = records * KERNEL_ROUNDS; /* one texture byte per tile */
+    }
+
+    free(styles);
+    free(out);
+    free(raw);
+}
+
+/* draws the start view over the largest window at every zoom and error budget */
+static void lod_sweep(unsigned frame_width, unsigned frame_height) {
+    struct Point3D point = { START_SECTOR_X, START_SECTOR_Y, START_SECTOR_H };
+    if (!world_open(&point, STREAM_WINDOW_MAX)) {
+        ABORT("cannot open sector: h%ux%uy%u", point.z, point.x, point.y);
+    }
+
+    for (unsigned z = 0; z < LOD_ZOOMS; z++) {
+        for (unsigned e = 0; e < LOD_ERRORS; e++) {
+            struct WorldView view = {
+                .terrain = {
+                    .tile_scale  = 4,
+                    .crop        = true,
+                    .terrain     = true,
+                    .walls       = true,
+                    .multi_story = true,
+                    .underground = true,
+                    .wire_frame  = true,
+                    .lod         = lod_errors[e] > 0
+                },
+                .lod_error = lod_errors[e],
+                .models = true
+            };
+            world_camera(&view, START_ANGLE_X, START_ANGLE_Y, lod_zooms[z], frame_width, frame_height);
+
+            /* the first frame builds the window's geometry */
+            raster_clear(0, 0, 0);
+            world_draw(&render_soft, &view);
+
+            double start = time_ms();
+            for (unsigned i = 0; i < LOD_FRAMES; i++) {
+                raster_clear(0, 0, 0);
+                world_draw(&render_soft, &view);
+            }
+
+            lod_results[z * LOD_ERRORS + e] = (struct LodResult) {
+                lod_zooms[z], lod_errors[e], frame_stats.screen_error,
+                frame_stats.triangles, frame_stats.lines, (time_ms() - start) / LOD_FRAMES
+            };
+        }
+    }
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-f csv|json] [-r <width> <height>] [-o <samples.csv>]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+    bool json = false;
+    unsigned frame_width = 320, frame_height = 180;
+    const char *samples_name = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+            i++;
+            if (!strcmp(argv[i], "json")) json = true;
+            else if (strcmp(argv[i], "csv")) usage(argv[0]);
+        } else if (!strcmp(argv[i], "-r") && i + 2 < argc) {
+            frame_width = atoi(argv[++i]);
+            frame_height = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            samples_name = argv[++i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    if (frame_width < 1 || frame_height < 1) {
+        usage(argv[0]);
+    }
+
+    FILE *samples_fp = NULL;
+    if (samples_name) {
+        samples_fp = fopen(samples_name, "w");
+        if (!samples_fp) {
+            ABORT("cannot open file: %s", samples_name);
+        }
+        fprintf(samples_fp, "plane,x,y,load_ms,lookup_ms,build_ms,draw_ms\n");
+    }
+
+    raster_init(frame_width, frame_height);
+    world_init(&render_soft);
+    world_load_textures(&render_soft, true);
+
+    struct SectorTiles *tiles = xmalloc(sizeof(struct SectorTiles));
+    struct Sector *sector = &sectors[0];
+    unsigned missing = 0;
+
+    for (uint16_t x = SECTOR_MIN_X; x < SECTOR_MIN_X + SECTOR_COLS; x++) {
+        for (uint16_t y = SECTOR_MIN_Y; y < SECTOR_MIN_Y + SECTOR_ROWS; y++) {
+            struct Point3D point = { x, y, 0 };
+            double load[SECTOR_PLANES];
+            bool loaded = true;
+
+            /* every plane is decoded into the tiles, the geometry of any plane needs all of them */
+            for (uint8_t plane = 0; plane < SECTOR_PLANES && loaded; plane++) {
+                double start = time_ms();
+                loaded = load_sector(tiles, &point, plane);
+                load[plane] = time_ms() - start;
+            }
+
+            if (!loaded) {
+                missing++;
+                continue;
+            }
+
+            for (uint8_t plane = 0; plane < SECTOR_PLANES; plane++) {
+                double times[STAGE_COUNT];
+                times[STAGE_LOAD] = load[plane];
+
+                double start = time_ms();
+                unsigned count;
+                struct ModelLoc *placements = placement_find(plane, x, y, &count);
+                times[STAGE_LOOKUP] = time_ms() - start;
+
+                /* a 1x1 window around this sector, as the viewer would show it */
+                struct WorldView view = {
+                    .terrain = {
+                        .tile_scale  = 4,
+                        .crop        = true,
+                        .terrain     = true,
+                        .walls       = true,
+                        .multi_story = plane == 0,
+                        .underground = plane == 0,
+                        .wire_frame  = true,
+                        .lod         = true
+                    },
+                    .models = true
+                };
+                sector->pos = (struct Point3D) { x, y, plane };
+                sector->tiles = tiles;
+                sector->placements = placements;
+                sector->num_models = count;
+                sector->used = true;
+                sector->mesh.built = false;
+                area.window[0][0] = sector;
+                area.size = 1;
+                area.curr = sector->pos;
+
+                /* the geometry and the chunk bounds, models included */
+                start = time_ms();
+                sector_prepare(sector, 0, 0, &view.terrain);
+                times[STAGE_BUILD] = time_ms() - start;
+
+                world_camera(&view, START_ANGLE_X, START_ANGLE_Y, START_ANGLE_Z, frame_width, frame_height);
+
+                start = time_ms();
+                raster_clear(0, 0, 0);
+                world_draw(&render_soft, &view);
+                times[STAGE_DRAW] = time_ms() - start;
+
+                for (unsigned stage = 0; stage < STAGE_COUNT; stage++) {
+                    samples[stage].values[samples[stage].count++] = times[stage];
+                }
+                if (samples_fp) {
+                    fprintf(samples_fp, "%u,%u,%u,%.4f,%.4f,%.4f,%.4f\n", plane, x, y,
+                        times[STAGE_LOAD], times[STAGE_LOOKUP], times[STAGE_BUILD], times[STAGE_DRAW]);
+                }
+            }
+        }
+    }
+
+    if (samples_fp && fclose(samples_fp) != 0) {
+        ABORT("cannot write file: %s", samples_name);
+    }
+
+    /* hand the borrowed sector back before the window streams its own */
+    sector->used = false;
+    sector->tiles = NULL;
+    area.window[0][0] = NULL;
+    area.size = 0;
+    free(tiles);
+
+    decode_models();
+    decode_kernel_sets();
+    lod_sweep(frame_width, frame_height);
+
+    if (json) {
+        printf("{\n  \"positions\": %u,\n  \"missing\": %u,\n  \"stages\": {\n", samples[0].count, missing);
+    } else {
+        printf("stage,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n");
+    }
+
+    for (unsigned stage = 0; stage < STAGE_COUNT; stage++) {
+        struct Samples *s = &samples[stage];
+        double sum = 0;
+        for (unsigned i = 0; i < s->count; i++) sum += s->values[i];
+        qsort(s->values, s->count, sizeof(double), compare_double);
+
+        double mean = s->count ? sum / s->count : 0;
+        double max = s->count ? s->values[s->count - 1] : 0;
+
+        if (json) {
+            printf("    \"%s\": { \"count\": %u, \"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p95_ms\": %.4f, "
+                   "\"p99_ms\": %.4f, \"max_ms\": %.4f }%s\n",
+                stage_names[stage], s->count, mean, percentile(s, 50), percentile(s, 95), percentile(s, 99),
+                max, stage + 1 < STAGE_COUNT ? "," : "");
+        } else {
+            printf("%s,%u,%.4f,%.4f,%.4f,%.4f,%.4f\n", stage_names[stage], s->count, mean,
+                percentile(s, 50), percentile(s, 95), percentile(s, 99), max);
+        }
+    }
+
+    if (json) {
+        printf("  },\n  \"decode\": {\n");
+    } else {
+        printf("\ndecode,files,rounds,bytes,ms,mb_per_s\n");
+    }
+
+    for (unsigned i = 0; i < num_results; i++) {
+        struct Throughput *r = &results[i];
+        double rate = r->ms > 0 ? r->bytes / 1e6 / (r->ms / 1000) : 0;
+
+        if (json) {
+            printf("    \"%s\": { \"files\": %u, \"rounds\": %u, \"bytes\": %zu, \"ms\": %.4f, \"mb_per_s\": %.1f }%s\n",
+                r->name, r->files, r->rounds, r->bytes, r->ms, rate, i + 1 < num_results ? "," : "");
+        } else {
+            printf("%s,%u,%u,%zu,%.4f,%.1f\n", r->name, r->files, r->rounds, r->bytes, r->ms, rate);
+        }
+    }
+
+    if (json) {
+        printf("  },\n  \"lod\": [\n");
+    } else {
+        printf("\nlod,zoom,max_error_px,screen_error_px,triangles,lines,draw_ms\n");
+    }
+
+    for (unsigned i = 0; i < LOD_ZOOMS * LOD_ERRORS; i++) {
+        struct LodResult *r = &lod_results[i];
+
+        if (json) {
+            printf("    { \"zoom\": %.0f, \"max_error_px\": %.0f, \"screen_error_px\": %.2f, \"triangles\": %u, "
+                   "\"lines\": %u, \"draw_ms\": %.4f }%s\n",
+                r->zoom, r->max_error, r->screen_error, r->triangles, r->lines, r->ms,
+                i + 1 < LOD_ZOOMS * LOD_ERRORS ? "," : "");
+        } else {
+            printf("lod,%.0f,%.0f,%.2f,%u,%u,%.4f\n", r->zoom, r->max_error, r->screen_error,
+                r->triangles, r->lines, r->ms);
+        }
+    }
+
+    if (json) {
+        printf("  ]\n}\n");
+    }
+
+    world_cleanup();
+    raster_cleanup();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+/*
+ * renders the world with the software backend, no window or GL needed. writes the
+ * last frame to a PPM and reports how long the frames took, for golden images and
+ * frame time comparisons on machines without a GPU.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "profile.h"
+#include "raster.h"
+#include "trace.h"
+#include "world.h"
+
+#define FRAME_WIDTH     1200
+#define FRAME_HEIGHT    650
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-s <x> <y> <plane>] [-w <window size>] [-f <frames>] [-z <zoom>] [-l <pixels>] "
+                    "[-r <width> <height>] [-o <output.ppm>] [-t <trace.csv>] [-T <trace.json>]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+    struct Point3D point = { START_SECTOR_X, START_SECTOR_Y, START_SECTOR_H };
+    unsigned window_size = 3, frames = 1;
+    unsigned frame_width = FRAME_WIDTH, frame_height = FRAME_HEIGHT;
+    float zoom = START_ANGLE_Z, lod_error = LOD_ERROR;
+    const char *outname = "frame.ppm";
+    const char *trace_name = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-s") && i + 3 < argc) {
+            point.x = atoi(argv[++i]);
+            point.y = atoi(argv[++i]);
+            point.z = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-w") && i + 1 < argc) {
+            window_size = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-z") && i + 1 < argc) {
+            zoom = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "-l") && i + 1 < argc) {
+            lod_error = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "-r") && i + 2 < argc) {
+            frame_width = atoi(argv[++i]);
+            frame_height = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            outname = argv[++i];
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            trace_name = argv[++i];
+        } else if (!strcmp(argv[i], "-T") && i + 1 < argc) {
+            if (!trace_open(argv[++i])) {
+                ABORT("cannot open file: %s", argv[i]);
+            }
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    if (window_size < 1 || window_size > STREAM_WINDOW_MAX || window_size % 2 == 0
+        || frames < 1 || frame_width < 1 || frame_height < 1) {
+        usage(argv[0]);
+    }
+
+    raster_init(frame_width, frame_height);
+    world_init(&render_soft);
+    world_load_textures(&render_soft, true);
+
+    if (!world_open(&point, window_size)) {
+        ABORT("cannot load sector: h%ux%uy%u", point.z, point.x, point.y);
+    }
+
+    /* the desktop viewer's defaults, seen from its start angle */
+    struct WorldView view = {
+        .terrain = {
+            .tile_scale  = 4,
+            .crop        = true,
+            .terrain     = true,
+            .walls       = true,
+            .multi_story = point.z == 0,
+            .underground = point.z == 0,
+            .wire_frame  = true,
+            .lod         = lod_error > 0
+        },
+        .lod_error = lod_error,
+        .models = true
+    };
+    world_camera(&view, START_ANGLE_X, START_ANGLE_Y, zoom, frame_width, frame_height);
+
+    double total = 0, slowest = 0;
+    for (unsigned i = 0; i < frames; i++) {
+        double start = time_ms();
+
+        profile_begin(PHASE_FRAME);
+        raster_clear(0, 0, 0);
+        world_draw(&render_soft, &view);
+        profile_end(PHASE_FRAME);
+
+        double elapsed = time_ms() - start;
+        total += elapsed;
+        if (elapsed > slowest) slowest = elapsed;
+    }
+
+    if (!raster_write_ppm(outname)) {
+        ABORT("cannot write file: %s", outname);
+    }
+
+    printf("h%ux%uy%u %ux%u window, %u visible (%u/%u chunks), %u models, %u draw calls\n",
+        point.z, point.x, point.y, window_size, window_size, frame_stats.visible_sectors,
+        frame_stats.visible_chunks, frame_stats.visible_chunks + frame_stats.culled_chunks,
+        num_models, frame_stats.draw_calls);
+    printf("%u triangles, %u lines, %u coarse chunks, %.2f px screen error\n",
+        frame_stats.triangles, frame_stats.lines, frame_stats.coarse_chunks, frame_stats.screen_error);
+    printf("%u frames at %ux%u: %.2f ms average, %.2f ms slowest, written to %s\n",
+        frames, frame_width, frame_height, total / frames, slowest, outname);
+    for (unsigned i = 0; i < PHASE_COUNT; i++) {
+        struct ProfileSummary phase = profile_summary(i);
+        if (phase.count) {
+            printf("  %-10s p50 %.2f ms, p95 %.2f ms, p99 %.2f ms\n", profile_phase_names[i], phase.p50, phase.p95, phase.p99);
+        }
+    }
+
+    if (trace_name && !profile_dump(trace_name)) {
+        ABORT("cannot write file: %s", trace_name);
+    }
+
+    trace_close();
+    world_cleanup();
+    raster_cleanup();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+/* compiles model_locs.csv into the fixed layout placement table (see placement.h for the layout) */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "placement.h"
+#include "util.h"
+
+#define MAX_PLACEMENTS  65536
+#define MAX_NAMES       65535
+
+static void put_le16(uint8_t *bytes, uint16_t value) {
+    bytes[0] = value & 0xFF;
+    bytes[1] = value >> 8;
+}
+
+static void put_le32(uint8_t *bytes, uint32_t value) {
+    bytes[0] = value & 0xFF;
+    bytes[1] = (value >> 8) & 0xFF;
+    bytes[2] = (value >> 16) & 0xFF;
+    bytes[3] = value >> 24;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <model_locs.csv> <table>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *inname = argv[1];
+    const char *outname = argv[2];
+
+    struct ModelLoc *locs = xmalloc(MAX_PLACEMENTS * sizeof(struct ModelLoc));
+    unsigned count = placement_load_csv(inname, locs, MAX_PLACEMENTS);
+
+    /* intern the names, every distinct name is stored once */
+    const char **names = xmalloc(MAX_NAMES * sizeof(char*));
+    uint32_t *offsets = xmalloc(MAX_NAMES * sizeof(uint32_t));
+    uint8_t *records = xmalloc((size_t) count * TABLE_RECORD_SIZE);
+    unsigned num_names = 0;
+    uint32_t strings_size = 0;
+
+    for (unsigned i = 0; i < count; i++) {
+        unsigned name = 0;
+        while (name < num_names && strcmp(names[name], locs[i].name) != 0) name++;
+
+        if (name == num_names) {
+            if (num_names == MAX_NAMES) {
+                ABORT("more than %u model names: %s", MAX_NAMES, inname);
+            }
+            names[num_names] = locs[i].name;
+            offsets[num_names] = strings_size;
+            strings_size += strlen(locs[i].name) + 1;
+            num_names++;
+        }
+
+        uint8_t *record = records + (size_t) i * TABLE_RECORD_SIZE;
+        memset(record, 0, TABLE_RECORD_SIZE);
+        put_le16(record, locs[i].x);
+        put_le16(record + 2, locs[i].y);
+        record[4] = locs[i].dir;
+        record[5] = locs[i].width;
+        record[6] = locs[i].height;
+        put_le16(record + 8, locs[i].id);
+        put_le16(record + 10, name);
+    }
+
+    uint8_t header[TABLE_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    memcpy(header, TABLE_MAGIC, 4);
+    put_le16(header + 4, TABLE_VERSION);
+    put_le32(header + 8, count);
+    put_le32(header + 12, num_names);
+    put_le32(header + 16, strings_size);
+
+    FILE *out = fopen(outname, "wb");
+    if (!out) {
+        ABORT("cannot open file: %s", outname);
+    }
+
+    fwrite(header, sizeof(header), 1, out);
+    fwrite(records, TABLE_RECORD_SIZE, count, out);
+    for (unsigned i = 0; i < num_names; i++) {
+        uint8_t offset[4];
+        put_le32(offset, offsets[i]);
+        fwrite(offset, sizeof(offset), 1, out);
+    }
+    for (unsigned i = 0; i < num_names; i++) {
+        fwrite(names[i], strlen(names[i]) + 1, 1, out);
+    }
+
+    if (fclose(out) != 0) {
+        ABORT("cannot write file: %s", outname);
+    }
+
+    printf("packed %u placements with %u model names into %s (%u bytes)\n", count, num_names, outname,
+        (unsigned) (sizeof(header) + count * TABLE_RECORD_SIZE + num_names * 4 + strings_size));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+/* packs the loose data/sectors files into a single archive (see sector.h for the layout) */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sector.h"
+#include "util.h"
+
+static void put_le16(uint8_t *bytes, uint16_t value) {
+    bytes[0] = value & 0xFF;
+    bytes[1] = value >> 8;
+}
+
+static void put_le32(uint8_t *bytes, uint32_t value) {
+    bytes[0] = value & 0xFF;
+    bytes[1] = (value >> 8) & 0xFF;
+    bytes[2] = (value >> 16) & 0xFF;
+    bytes[3] = value >> 24;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <sector dir> <archive>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *dirname = argv[1];
+    const char *outname = argv[2];
+
+    uint8_t header[ARCHIVE_HEADER_SIZE + ARCHIVE_INDEX_SIZE];
+    memset(header, 0, sizeof(header));
+    memcpy(header, ARCHIVE_MAGIC, 4);
+    put_le16(header + 4,  ARCHIVE_VERSION);
+    put_le16(header + 6,  SECTOR_PLANES);
+    put_le16(header + 8,  SECTOR_MIN_X);
+    put_le16(header + 10, SECTOR_MIN_Y);
+    put_le16(header + 12, SECTOR_COLS);
+    put_le16(header + 14, SECTOR_ROWS);
+
+    FILE *out = fopen(outname, "wb");
+    if (!out) {
+        ABORT("cannot open file: %s", outname);
+    }
+
+    /* reserve space for the header and index, they're written last */
+    fwrite(header, sizeof(header), 1, out);
+
+    uint32_t offset = sizeof(header);
+    uint32_t raw_size = 0;
+    unsigned count = 0;
+
+    for (uint8_t plane = 0; plane < SECTOR_PLANES; plane++) {
+        for (uint16_t x = SECTOR_MIN_X; x < SECTOR_MIN_X + SECTOR_COLS; x++) {
+            for (uint16_t y = SECTOR_MIN_Y; y < SECTOR_MIN_Y + SECTOR_ROWS; y++) {
+                char fname[256];
+                snprintf(fname, sizeof(fname), "%sh%ux%uy%u", dirname, plane, x, y);
+
+                FILE *fp = fopen(fname, "rb");
+                if (!fp) {
+                    continue; /* sector left absent in the index */
+                }
+
+                uint8_t buf[SECTOR_SIZE];
+                if (file_length(fp) != SECTOR_SIZE || fread(buf, sizeof(buf), 1, fp) != 1) {
+                    ABORT("invalid sector file: %s", fname);
+                }
+                fclose(fp);
+
+                /* keep the sector uncompressed if the codec doesn't pay off */
+                uint8_t packed[SECTOR_SIZE + SECTOR_SIZE / 128 + 1];
+                size_t length = sector_encode_rle(buf, packed);
+                uint8_t codec = CODEC_RLE;
+
+                if (length >= SECTOR_SIZE) {
+                    memcpy(packed, buf, SECTOR_SIZE);
+                    length = SECTOR_SIZE;
+                    codec = CODEC_RAW;
+                }
+
+                fwrite(packed, length, 1, out);
+
+                uint8_t *entry = header + ARCHIVE_HEADER_SIZE + sector_index(plane, x, y) * ARCHIVE_ENTRY_SIZE;
+                put_le32(entry, offset);
+                put_le16(entry + 4, length);
+                entry[6] = codec;
+
+                offset += length;
+                raw_size += SECTOR_SIZE;
+                count++;
+            }
+        }
+    }
+
+    rewind(out);
+    fwrite(header, sizeof(header), 1, out);
+
+    if (fclose(out) != 0) {
+        ABORT("cannot write file: %s", outname);
+    }
+
+    printf("packed %u sectors into %s (%u of %u bytes)\n", count, outname, offset, raw_size);
+
+    return EXIT_SUCCESS;
+}